@@ -0,0 +1,218 @@
+#include "D1Batch.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define D1_BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define D1_TARGET(x)
+#else
+#define D1_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+namespace D1 {
+
+static inline double scaled(int32_t v, size_t f) {
+	switch (f) {
+	case Pan:
+	case Tilt:
+	case Roll:
+		return v / 32768.0;
+	case X:
+	case Y:
+	case Height:
+		return v / 64.0 * 0.001;
+	default:
+		return v - 0x80000;
+	}
+}
+
+void decodeBatchScalar(const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]) {
+	for (size_t i = 0; i < n; i++) {
+		const uint8_t* p = frames + i * stride;
+		for (size_t f = 0; f < FIELDS; f++) {
+			columns[f][i] = scaled(field(p, (Field)f), f);
+		}
+	}
+}
+
+#ifdef D1_BATCH_X86
+
+// Each 24 bit big endian field goes to the top three bytes of a 32 bit
+// lane, an arithmetic shift by 8 then sign extends it.
+// lo covers frame bytes 2-17 (pan, tilt, roll, x),
+// hi covers frame bytes 10-25 (y, height, zoom, focus).
+D1_TARGET("ssse3")
+static inline void loadFields(const uint8_t* p, __m128i& lo, __m128i& hi) {
+	const __m128i maskLo = _mm_setr_epi8(
+		-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9);
+	const __m128i maskHi = _mm_setr_epi8(
+		-1, 6, 5, 4, -1, 9, 8, 7, -1, 12, 11, 10, -1, 15, 14, 13);
+	lo = _mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 2)), maskLo), 8);
+	hi = _mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 10)), maskHi), 8);
+}
+
+// 4 frames x 4 fields -> 4 fields x 4 frames
+D1_TARGET("ssse3")
+static inline void transpose(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3) {
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+	r0 = _mm_unpacklo_epi64(t0, t1);
+	r1 = _mm_unpackhi_epi64(t0, t1);
+	r2 = _mm_unpacklo_epi64(t2, t3);
+	r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+D1_TARGET("ssse3")
+static inline void store4(double* dst, __m128i v, size_t f) {
+	__m128d a = _mm_cvtepi32_pd(v);
+	__m128d b = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+	if (f <= Roll) {
+		const __m128d s = _mm_set1_pd(1.0 / 32768.0);
+		a = _mm_mul_pd(a, s);
+		b = _mm_mul_pd(b, s);
+	}
+	else if (f <= Height) {
+		const __m128d s = _mm_set1_pd(1.0 / 64.0);
+		const __m128d mm = _mm_set1_pd(0.001);
+		a = _mm_mul_pd(_mm_mul_pd(a, s), mm);
+		b = _mm_mul_pd(_mm_mul_pd(b, s), mm);
+	}
+	else {
+		const __m128d o = _mm_set1_pd((double)0x80000);
+		a = _mm_sub_pd(a, o);
+		b = _mm_sub_pd(b, o);
+	}
+	_mm_storeu_pd(dst, a);
+	_mm_storeu_pd(dst + 2, b);
+}
+
+D1_TARGET("avx2")
+static inline void store4Avx(double* dst, __m128i v, size_t f) {
+	__m256d a = _mm256_cvtepi32_pd(v);
+	if (f <= Roll)
+		a = _mm256_mul_pd(a, _mm256_set1_pd(1.0 / 32768.0));
+	else if (f <= Height)
+		a = _mm256_mul_pd(_mm256_mul_pd(a, _mm256_set1_pd(1.0 / 64.0)), _mm256_set1_pd(0.001));
+	else
+		a = _mm256_sub_pd(a, _mm256_set1_pd((double)0x80000));
+	_mm256_storeu_pd(dst, a);
+}
+
+D1_TARGET("ssse3")
+static inline void loadBlock(const uint8_t* p, size_t stride, __m128i cols[FIELDS]) {
+	loadFields(p, cols[0], cols[4]);
+	loadFields(p + stride, cols[1], cols[5]);
+	loadFields(p + stride * 2, cols[2], cols[6]);
+	loadFields(p + stride * 3, cols[3], cols[7]);
+	transpose(cols[0], cols[1], cols[2], cols[3]);
+	transpose(cols[4], cols[5], cols[6], cols[7]);
+}
+
+D1_TARGET("ssse3")
+static void decodeBatchSsse3(const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i cols[FIELDS];
+		loadBlock(frames + i * stride, stride, cols);
+		for (size_t f = 0; f < FIELDS; f++) {
+			store4(columns[f] + i, cols[f], f);
+		}
+	}
+	double* rest[FIELDS];
+	for (size_t f = 0; f < FIELDS; f++) {
+		rest[f] = columns[f] + i;
+	}
+	decodeBatchScalar(frames + i * stride, n - i, stride, rest);
+}
+
+D1_TARGET("avx2")
+static void decodeBatchAvx2(const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i cols[FIELDS];
+		loadBlock(frames + i * stride, stride, cols);
+		for (size_t f = 0; f < FIELDS; f++) {
+			store4Avx(columns[f] + i, cols[f], f);
+		}
+	}
+	double* rest[FIELDS];
+	for (size_t f = 0; f < FIELDS; f++) {
+		rest[f] = columns[f] + i;
+	}
+	decodeBatchScalar(frames + i * stride, n - i, stride, rest);
+}
+
+struct Features {
+	bool ssse3;
+	bool avx2;
+};
+
+static Features detect() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool ssse3 = (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool ssse3 = __builtin_cpu_supports("ssse3");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	return { ssse3, avx2 };
+}
+
+bool supports(Isa isa) {
+	static const Features features = detect();
+	switch (isa) {
+	case Isa::Avx2:
+		return features.avx2;
+	case Isa::Ssse3:
+		return features.ssse3;
+	default:
+		return true;
+	}
+}
+
+void decodeBatch(Isa isa, const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]) {
+	switch (isa) {
+	case Isa::Avx2:
+		decodeBatchAvx2(frames, n, stride, columns);
+		break;
+	case Isa::Ssse3:
+		decodeBatchSsse3(frames, n, stride, columns);
+		break;
+	default:
+		decodeBatchScalar(frames, n, stride, columns);
+		break;
+	}
+}
+
+#else
+
+bool supports(Isa isa) {
+	return isa == Isa::Scalar;
+}
+
+void decodeBatch(Isa, const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]) {
+	decodeBatchScalar(frames, n, stride, columns);
+}
+
+#endif
+
+void decodeBatch(const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]) {
+	static const Isa best = supports(Isa::Avx2) ? Isa::Avx2 : supports(Isa::Ssse3) ? Isa::Ssse3 : Isa::Scalar;
+	decodeBatch(best, frames, n, stride, columns);
+}
+
+}
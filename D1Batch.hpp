@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "D1Packet.hpp"
+
+namespace D1 {
+
+// Decodes n validated frames into one column per Field.
+// Frame i starts at frames + i * stride (stride >= FRAME). Columns receive
+// the same values as the scalar helpers in D1Packet.hpp: deg for
+// pan/tilt/roll, m for x/y/height and the raw lens value minus 0x80000 for
+// zoom/focus, bit for bit. Uses AVX2 or SSSE3 when the CPU has them.
+void decodeBatch(const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]);
+
+// Portable reference path, always scalar.
+void decodeBatchScalar(const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]);
+
+// The code paths decodeBatch picks from, to test and time them one by one.
+enum class Isa { Scalar, Ssse3, Avx2 };
+
+// whether this build and CPU can run isa
+bool supports(Isa isa);
+
+// decodeBatch on the given path, which must be supported
+void decodeBatch(Isa isa, const uint8_t* frames, size_t n, size_t stride, double* const columns[FIELDS]);
+
+}
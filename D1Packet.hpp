@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Radamec D1 camera data packet (29 bytes)
+//
+//  0      0xD1
+//  1      camera id
+//  2- 4   pan     24 bit signed, 1/32768 deg
+//  5- 7   tilt
+//  8-10   roll
+// 11-13   x       24 bit signed, 1/64 mm
+// 14-16   y
+// 17-19   height
+// 20-22   zoom    24 bit, 0x80000 offset
+// 23-25   focus
+// 26-27   spare
+// 28      checksum: 0x40 - sum of bytes 0-27
+namespace D1 {
+
+constexpr size_t FRAME = 29;
+constexpr uint8_t SYNC = 0xd1;
+constexpr size_t CAMERA_ID = 1;
+constexpr size_t CHECKSUM = 28;
+
+enum Field { Pan, Tilt, Roll, X, Y, Height, Zoom, Focus, FIELDS };
+
+constexpr size_t OFFSETS[FIELDS] = { 2, 5, 8, 11, 14, 17, 20, 23 };
+
+constexpr int32_t signExtend24(uint32_t v) {
+	return (int32_t)(v & 0x7fffff) - (int32_t)(v & 0x800000);
+}
+
+constexpr int32_t field(const uint8_t* p, Field f) {
+	return signExtend24(
+		((uint32_t)p[OFFSETS[f]] << 16) |
+		((uint32_t)p[OFFSETS[f] + 1] << 8) |
+		(uint32_t)p[OFFSETS[f] + 2]);
+}
+
+constexpr uint8_t checkSum(const uint8_t* p) {
+	uint32_t s = 0;
+	for (size_t i = 0; i < CHECKSUM; i++) {
+		s += p[i];
+	}
+	return (uint8_t)(0x40 - (s & 0xff));
+}
+
+constexpr bool isValid(const uint8_t* p) {
+	return p[0] == SYNC && p[CHECKSUM] == checkSum(p);
+}
+
+// decoded packet in channel order, before offsets and lens normalization
+struct Pose {
+	double tx, ty, tz;	// m
+	double rx, ry, rz;	// deg
+	int32_t zoom, focus;	// raw lens, 0x80000 removed
+};
+
+// same arithmetic as the original readTransformation(), so results are bit exact
+constexpr double position(const uint8_t* p, Field f) {
+	return field(p, f) / 64.0 * 0.001;
+}
+
+constexpr double rotation(const uint8_t* p, Field f) {
+	return field(p, f) / 32768.0;
+}
+
+constexpr int32_t lens(const uint8_t* p, Field f) {
+	return field(p, f) - 0x80000;
+}
+
+constexpr Pose decode(const uint8_t* p) {
+	return Pose{
+		position(p, X), position(p, Height), position(p, Y),
+		rotation(p, Tilt), rotation(p, Pan), rotation(p, Roll),
+		lens(p, Zoom), lens(p, Focus),
+	};
+}
+
+namespace detail {
+
+constexpr uint8_t SAMPLE[FRAME] = {
+	0xd1, 0x01,
+	0x01, 0x23, 0x45,	// pan
+	0xfe, 0xdc, 0xba,	// tilt
+	0x00, 0x00, 0x00,	// roll
+	0x7f, 0xff, 0xff,	// x
+	0x80, 0x00, 0x00,	// y
+	0xff, 0xff, 0xff,	// height
+	0x8a, 0x00, 0x00,	// zoom
+	0x7c, 0x00, 0x00,	// focus
+	0x00, 0x00,
+	0x71,
+};
+
+static_assert(signExtend24(0x000000) == 0, "");
+static_assert(signExtend24(0x7fffff) == 8388607, "");
+static_assert(signExtend24(0x800000) == -8388608, "");
+static_assert(signExtend24(0xffffff) == -1, "");
+
+static_assert(isValid(SAMPLE), "");
+static_assert(checkSum(SAMPLE) == 0x71, "");
+
+static_assert(field(SAMPLE, Pan) == 0x012345, "");
+static_assert(field(SAMPLE, Tilt) == -0x012346, "");
+static_assert(field(SAMPLE, Roll) == 0, "");
+static_assert(field(SAMPLE, X) == 8388607, "");
+static_assert(field(SAMPLE, Y) == -8388608, "");
+static_assert(field(SAMPLE, Height) == -1, "");
+
+static_assert(decode(SAMPLE).ry == 74565 / 32768.0, "");
+static_assert(decode(SAMPLE).rx == -74566 / 32768.0, "");
+static_assert(decode(SAMPLE).tx == 8388607 / 64.0 * 0.001, "");
+static_assert(decode(SAMPLE).ty == -1 / 64.0 * 0.001, "");
+static_assert(decode(SAMPLE).tz == -8388608 / 64.0 * 0.001, "");
+static_assert(decode(SAMPLE).zoom == -0x760000 - 0x80000, "");
+static_assert(decode(SAMPLE).focus == 0x7c0000 - 0x80000, "");
+
+}
+
+}
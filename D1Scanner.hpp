@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "D1Packet.hpp"
+
+// Finds D1 frames in a byte stream one read chunk at a time.
+// Candidates start at a 0xD1 sync byte and are validated in place; a
+// rejected candidate only skips its sync byte, so a real frame starting
+// inside the rejected window is still found. Every byte is searched once
+// and each candidate costs at most one validation, so the scan stays
+// linear even on a stream of nothing but sync bytes.
+class D1Scanner {
+public:
+	static constexpr size_t FRAME = D1::FRAME;
+	static constexpr uint8_t SYNC = D1::SYNC;
+
+	// times frame alignment was lost after a good frame, a run of rejected
+	// candidates counts once
+	uint64_t resyncs = 0;
+	// candidates that failed validation
+	uint64_t rejected = 0;
+	// bytes that ended up in no frame
+	uint64_t discarded = 0;
+
+	void reset() {
+		carryLen = 0;
+		synced = false;
+	}
+
+	// valid(const uint8_t*) -> bool decides whether a candidate is a frame,
+	// emit(const uint8_t*, size_t end) receives every accepted frame and the
+	// offset in this chunk just past its last byte.
+	template <typename Valid, typename Emit>
+	void feed(const uint8_t* data, size_t n, Valid&& valid, Emit&& emit) {
+		size_t pos = 0;
+
+		// finish candidates that started in the previous chunk
+		if (carryLen > 0) {
+			size_t k = n < FRAME - 1 ? n : FRAME - 1;
+			memcpy(carry + carryLen, data, k);
+			size_t stitchLen = carryLen + k;
+			size_t before = carryLen;
+
+			size_t p = 0;
+			while (p < carryLen) {
+				if (stitchLen - p < FRAME) {
+					memmove(carry, carry + p, stitchLen - p);
+					carryLen = stitchLen - p;
+					return;
+				}
+				if (valid(carry + p)) {
+					emit(carry + p, p + FRAME - before);
+					synced = true;
+					p += FRAME;
+					continue;
+				}
+				reject();
+				p = next(carry, p + 1, carryLen);
+			}
+			carryLen = 0;
+			pos = p - before;
+		}
+
+		while (pos < n) {
+			pos = next(data, pos, n);
+			if (pos == n)
+				break;
+			if (n - pos < FRAME) {
+				memcpy(carry, data + pos, n - pos);
+				carryLen = n - pos;
+				break;
+			}
+			if (valid(data + pos)) {
+				emit(data + pos, pos + FRAME);
+				synced = true;
+				pos += FRAME;
+				continue;
+			}
+			reject();
+			pos++;
+		}
+	}
+
+private:
+	uint8_t carry[FRAME * 2];
+	size_t carryLen = 0;
+	bool synced = false;
+
+	void reject() {
+		if (synced)
+			this->resyncs++;
+		synced = false;
+		this->rejected++;
+		this->discarded++;
+	}
+
+	// next sync byte in [from, end), or end; skipped bytes count as discarded
+	size_t next(const uint8_t* buf, size_t from, size_t end) {
+		if (from >= end)
+			return from;
+		const void* q = memchr(buf + from, SYNC, end - from);
+		size_t at = q ? (size_t)((const uint8_t*)q - buf) : end;
+		this->discarded += at - from;
+		return at;
+	}
+};
@@ -0,0 +1,91 @@
+#include "Derivative.hpp"
+
+#include <cmath>
+
+// a reconnect or a long dropout starts the window over
+static const int64_t GAP_NS = 500000000;
+
+void Differentiator::add(int64_t time, const D1::Pose& pose, size_t window,
+	double velocity[TimedPose::VALUES], double acceleration[TimedPose::VALUES])
+{
+	const size_t V = TimedPose::VALUES;
+
+	if (this->count) {
+		int64_t gap = time - this->frames[(this->next + MAX_WINDOW - 1) % MAX_WINDOW].time;
+		if (gap > GAP_NS || gap < 0)
+			this->count = 0;
+	}
+
+	this->frames[this->next] = { time, { pose.tx, pose.ty, pose.tz, pose.rx, pose.ry, pose.rz, (double)pose.zoom, (double)pose.focus } };
+	this->next = (this->next + 1) % MAX_WINDOW;
+	if (this->count < MAX_WINDOW)
+		this->count++;
+
+	for (size_t f = 0; f < V; f++) {
+		velocity[f] = 0.0;
+		acceleration[f] = 0.0;
+	}
+
+	if (window > MAX_WINDOW)
+		window = MAX_WINDOW;
+	size_t n = this->count < window ? this->count : window;
+	if (n < 2)
+		return;
+
+	// j = 0 is the newest frame; times in s and values relative to it
+	double tau[MAX_WINDOW];
+	double y[MAX_WINDOW][V];
+	const TimedPose& newest = this->frames[(this->next + MAX_WINDOW - 1) % MAX_WINDOW];
+	for (size_t j = 0; j < n; j++) {
+		const TimedPose& e = this->frames[(this->next + MAX_WINDOW - 1 - j) % MAX_WINDOW];
+		tau[j] = (e.time - newest.time) / 1e9;
+		for (size_t f = 0; f < V; f++) {
+			y[j][f] = TimedPose::isAngle(f) ? -angleDelta(e.v[f], newest.v[f]) : e.v[f] - newest.v[f];
+		}
+	}
+
+	// weights so that velocity = sum w1[j] * y[j], acceleration = sum w2[j] * y[j]
+	double w1[MAX_WINDOW] = {};
+	double w2[MAX_WINDOW] = {};
+
+	// normal equations of y = c0 + c1 tau + c2 tau^2
+	double s[5] = {};
+	for (size_t j = 0; j < n; j++) {
+		double p = 1.0;
+		for (int k = 0; k < 5; k++) {
+			s[k] += p;
+			p *= tau[j];
+		}
+	}
+	// inverse of [[s0 s1 s2] [s1 s2 s3] [s2 s3 s4]], rows 1 and 2 are all we need
+	double i10 = s[2] * s[3] - s[1] * s[4];
+	double i11 = s[0] * s[4] - s[2] * s[2];
+	double i12 = s[1] * s[2] - s[0] * s[3];
+	double i20 = s[1] * s[3] - s[2] * s[2];
+	double i21 = s[1] * s[2] - s[0] * s[3];
+	double i22 = s[0] * s[2] - s[1] * s[1];
+	double det = s[0] * (s[2] * s[4] - s[3] * s[3]) + s[1] * i10 + s[2] * i20;
+
+	// the span scales det by its sixth power, compare against that
+	double span = -tau[n - 1];
+	if (n >= 3 && span > 0.0 && std::fabs(det) > 1e-12 * std::pow(span, 6.0) * n * n * n) {
+		for (size_t j = 0; j < n; j++) {
+			double t = tau[j];
+			w1[j] = (i10 + i11 * t + i12 * t * t) / det;
+			w2[j] = 2.0 * (i20 + i21 * t + i22 * t * t) / det;
+		}
+	}
+	else if (span > 0.0) {
+		// two frames, or times too close to fit a curve: a plain difference
+		w1[n - 1] = -1.0 / span;
+	}
+	else
+		return;
+
+	for (size_t j = 0; j < n; j++) {
+		for (size_t f = 0; f < V; f++) {
+			velocity[f] += w1[j] * y[j][f];
+			acceleration[f] += w2[j] * y[j][f];
+		}
+	}
+}
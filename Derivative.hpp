@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "D1Packet.hpp"
+#include "PoseHistory.hpp"
+
+// Velocity and acceleration of the eight pose values at the newest frame,
+// run by the receiver on every frame of a camera. A Savitzky-Golay style
+// least squares quadratic over the last `window` frames, on their real
+// timestamps: the weights are solved once per frame from the times and
+// then applied to all eight values at once. Units per s and per s^2,
+// angles unwrapped across +-180. A gap of more than half a second, or a
+// frame older than the last, starts the window over.
+class Differentiator {
+public:
+	static const size_t MAX_WINDOW = 9;
+
+	void reset() { count = 0; }
+
+	void add(int64_t time, const D1::Pose& pose, size_t window,
+		double velocity[TimedPose::VALUES], double acceleration[TimedPose::VALUES]);
+
+private:
+	TimedPose frames[MAX_WINDOW];
+	size_t next = 0;
+	size_t count = 0;
+};
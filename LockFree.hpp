@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Single producer / single consumer latest-value exchange.
+// The producer fills writeBuffer() and calls publish(); the consumer calls
+// update() and reads readBuffer(). Neither side ever blocks and the consumer
+// always sees one complete value.
+template <typename T>
+class TripleBuffer {
+	struct alignas(64) Slot {
+		T value;
+	};
+
+	static constexpr uint8_t INDEX = 0x03;
+	static constexpr uint8_t DIRTY = 0x04;
+
+	Slot slots[3];
+	alignas(64) std::atomic<uint8_t> middle;
+	alignas(64) uint8_t back;
+	alignas(64) uint8_t front;
+
+public:
+	TripleBuffer() : slots{}, middle(1), back(0), front(2) {}
+	TripleBuffer(const TripleBuffer&) = delete;
+
+	// producer side
+	T& writeBuffer() {
+		return slots[back].value;
+	}
+
+	void publish() {
+		back = middle.exchange(back | DIRTY, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// consumer side
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & DIRTY))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	const T& readBuffer() const {
+		return slots[front].value;
+	}
+};
+
+// Bounded single producer / single consumer queue.
+// Capacity must be a power of two. push() fails instead of blocking when full.
+template <typename T, size_t Capacity>
+class SpscQueue {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	T items[Capacity];
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+
+public:
+	SpscQueue() : items{}, head(0), tail(0) {}
+	SpscQueue(const SpscQueue&) = delete;
+
+	bool push(const T& item) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity)
+			return false;
+		items[t & (Capacity - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& item) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		item = items[h & (Capacity - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+};
+
+// Bounded multi producer / single consumer queue.
+// Every cell carries a sequence number, so producers only contend on one
+// compare-exchange of head and never wait for each other. Capacity must be
+// a power of two. push() fails instead of blocking when full.
+template <typename T, size_t Capacity>
+class MpscQueue {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	struct Cell {
+		std::atomic<size_t> seq;
+		T value;
+	};
+
+	Cell cells[Capacity];
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) size_t tail;
+
+public:
+	MpscQueue() : head(0), tail(0) {
+		for (size_t i = 0; i < Capacity; i++) {
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+	MpscQueue(const MpscQueue&) = delete;
+
+	// any thread
+	bool push(const T& item) {
+		return emplace([&item](T& value) { value = item; });
+	}
+
+	// fill(T&) writes the item in place
+	template <typename Fill>
+	bool emplace(Fill&& fill) {
+		size_t pos = head.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells[pos & (Capacity - 1)];
+			size_t seq = cell.seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					fill(cell.value);
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			else {
+				pos = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// consumer thread only
+	bool pop(T& item) {
+		Cell& cell = cells[tail & (Capacity - 1)];
+		if (cell.seq.load(std::memory_order_acquire) != tail + 1)
+			return false;
+		item = cell.value;
+		cell.seq.store(tail + Capacity, std::memory_order_release);
+		tail++;
+		return true;
+	}
+};
@@ -0,0 +1,223 @@
+#include "Logger.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+static const char* FORMATS[Logger::CODES] = {
+	"%s opened",
+	"%s lost, %g read errors, silent for %g ms",
+	"%s open failed, retry in %g ms",
+	"%s read error",
+	"%s resync, %g bytes discarded so far",
+	"%s %g ms without a frame",
+};
+
+static const char* LEVELS[] = { "INFO ", "WARN ", "ERROR" };
+
+static int64_t steadyNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Logger& Logger::Instance()
+{
+	static Logger logger;
+	return logger;
+}
+
+Logger::Logger()
+{
+}
+
+Logger::~Logger()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	if (this->writer.joinable())
+		this->writer.join();
+}
+
+void Logger::Log(Level level, Code code, const char* port, double a, double b, double c, double d)
+{
+	if (!this->enabled.load(std::memory_order_relaxed))
+		return;
+	this->LogAt(steadyNs(), level, code, port, a, b, c, d);
+}
+
+void Logger::LogAt(int64_t time, Level level, Code code, const char* port, double a, double b, double c, double d)
+{
+	if (!this->enabled.load(std::memory_order_relaxed))
+		return;
+
+	if (!port)
+		port = "";
+	bool queued = this->ring.emplace([&](Record& r) {
+		r.time = time;
+		r.code = (uint16_t)code;
+		r.level = (uint8_t)level;
+		// long by-id paths keep their distinctive end
+		size_t n = strlen(port);
+		size_t k = n < sizeof(r.port) ? n : sizeof(r.port) - 1;
+		memcpy(r.port, port + n - k, k);
+		r.port[k] = 0;
+		r.args[0] = a;
+		r.args[1] = b;
+		r.args[2] = c;
+		r.args[3] = d;
+	});
+	if (!queued)
+		this->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::SetFile(const std::string& path, size_t maxBytes, int keep)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (path == this->path && maxBytes == this->maxBytes && keep == this->keep)
+			return;
+		this->path = path;
+		this->maxBytes = maxBytes;
+		this->keep = keep;
+		this->reopen = true;
+		if (!this->writer.joinable()) {
+			this->writer = std::thread([this]() {
+				this->writerLoop();
+			});
+		}
+	}
+	this->enabled = !path.empty();
+	this->wake.notify_all();
+}
+
+static void lowerPriority()
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+}
+
+static void rotate(const std::string& path, int keep)
+{
+	for (int i = keep - 1; i >= 1; i--) {
+		std::string from = path + "." + std::to_string(i);
+		std::string to = path + "." + std::to_string(i + 1);
+		remove(to.c_str());
+		rename(from.c_str(), to.c_str());
+	}
+	std::string first = path + ".1";
+	remove(first.c_str());
+	if (keep > 0)
+		rename(path.c_str(), first.c_str());
+	else
+		remove(path.c_str());
+}
+
+void Logger::writerLoop()
+{
+	lowerPriority();
+
+	// records carry steady_clock time, the file shows wall clock time
+	int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count() - steadyNs();
+
+	FILE* file = nullptr;
+	size_t size = 0;
+	std::string path;
+	size_t maxBytes = 0;
+	int keep = 0;
+	uint64_t reportedDrops = 0;
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	while (!this->stopping)
+	{
+		this->wake.wait_for(lock, std::chrono::milliseconds(50));
+
+		bool reopen = this->reopen;
+		this->reopen = false;
+		if (reopen) {
+			path = this->path;
+			maxBytes = this->maxBytes;
+			keep = this->keep;
+		}
+		bool finishing = this->stopping;
+		lock.unlock();
+
+		// file I/O only without the lock, SetFile never waits for it
+		if (reopen) {
+			if (file)
+				fclose(file);
+			file = path.empty() ? nullptr : fopen(path.c_str(), "a");
+			size = 0;
+			if (file) {
+				fseek(file, 0, SEEK_END);
+				size = (size_t)ftell(file);
+			}
+		}
+
+		Record r;
+		while (this->ring.pop(r)) {
+			if (!file)
+				continue;
+
+			int64_t wall = r.time + offset;
+			time_t sec = (time_t)(wall / 1000000000LL);
+			struct tm t;
+#ifdef _WIN32
+			localtime_s(&t, &sec);
+#else
+			localtime_r(&sec, &t);
+#endif
+			char stamp[32];
+			strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &t);
+
+			char text[256];
+			const char* format = r.code < CODES ? FORMATS[r.code] : "%s ?";
+			snprintf(text, sizeof(text), format, r.port, r.args[0], r.args[1], r.args[2], r.args[3]);
+
+			int n = fprintf(file, "%s.%06d %s %s\n", stamp, (int)(wall % 1000000000LL / 1000), LEVELS[r.level < 3 ? r.level : 2], text);
+			if (n > 0)
+				size += n;
+			this->written.fetch_add(1, std::memory_order_relaxed);
+
+			if (maxBytes && size >= maxBytes) {
+				fclose(file);
+				rotate(path, keep);
+				file = fopen(path.c_str(), "a");
+				size = 0;
+			}
+		}
+
+		uint64_t drops = this->dropped.load(std::memory_order_relaxed);
+		if (file && drops != reportedDrops) {
+			fprintf(file, "%llu records dropped, ring full\n", (unsigned long long)(drops - reportedDrops));
+			reportedDrops = drops;
+		}
+		if (file)
+			fflush(file);
+
+		lock.lock();
+		if (finishing)
+			break;
+	}
+
+	if (file)
+		fclose(file);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "LockFree.hpp"
+
+// Process wide event log for post-mortems.
+// Log() only copies a small record into a lock-free ring; a low priority
+// writer thread formats the records and appends them to a rotating file.
+// When the ring is full records are dropped and counted, a caller never
+// waits. Nothing is recorded while no file is set.
+class Logger {
+public:
+	enum Level { Info, Warning, Error };
+
+	// every format starts with the port name, followed by up to four numbers
+	enum Code {
+		PortOpened,	// "%s opened"
+		PortLost,	// "%s lost, %g read errors, silent for %g ms"
+		OpenFailed,	// "%s open failed, retry in %g ms"
+		ReadError,	// "%s read error"
+		Resync,		// "%s resync, %g bytes discarded so far"
+		FrameGap,	// "%s %g ms without a frame"
+		CODES
+	};
+
+	static Logger& Instance();
+
+	Logger();
+	Logger(const Logger&) = delete;
+	~Logger();
+
+	// any thread, never blocks
+	void Log(Level level, Code code, const char* port, double a = 0.0, double b = 0.0, double c = 0.0, double d = 0.0);
+	// same with a steady_clock ns time the caller already has, saves the clock read
+	void LogAt(int64_t time, Level level, Code code, const char* port, double a = 0.0, double b = 0.0, double c = 0.0, double d = 0.0);
+
+	// empty path stops logging; files rotate to path.1 ... path.keep
+	void SetFile(const std::string& path, size_t maxBytes = 1 << 20, int keep = 3);
+	uint64_t Dropped() const { return dropped; }
+	uint64_t Written() const { return written; }
+
+private:
+	struct Record {
+		int64_t time;	// steady_clock ns
+		uint16_t code;
+		uint8_t level;
+		char port[29];	// tail of the name
+		double args[4];
+	};
+
+	MpscQueue<Record, 1024> ring;
+	std::atomic<bool> enabled{ false };
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<uint64_t> written{ 0 };
+
+	// writer thread
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread writer;
+	bool stopping = false;
+	std::string path;
+	size_t maxBytes = 0;
+	int keep = 0;
+	bool reopen = false;
+
+	void writerLoop();
+};
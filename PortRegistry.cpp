@@ -0,0 +1,471 @@
+#include "PortRegistry.hpp"
+#include "Reactor.hpp"
+#include "Logger.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+bool Mailbox::Deliver(const uint8_t* data, int64_t time)
+{
+	if (!this->multicamera && data[D1::CAMERA_ID] != this->cameraid) {
+		this->idMismatches.fetch_add(1, std::memory_order_relaxed);
+		this->lastOtherId.store(data[D1::CAMERA_ID], std::memory_order_relaxed);
+		return false;
+	}
+
+	Camera& cam = this->cameras[data[D1::CAMERA_ID]];
+
+	this->packets++;
+	cam.rate.add(time);
+	this->trackLenzRange(cam, data);
+
+	Sample& sample = cam.samples.writeBuffer();
+	memcpy(sample.frame, data, D1::FRAME);
+	sample.time = time;
+	sample.zoom_min = cam.zoom_min;
+	sample.zoom_max = cam.zoom_max;
+	sample.focus_min = cam.focus_min;
+	sample.focus_max = cam.focus_max;
+	sample.fps = cam.rate.rate();
+	sample.fpsavg = cam.rate.rateLong();
+	sample.interval = cam.rate.intervalMean();
+	sample.intervalMin = cam.rate.intervalMin();
+	sample.intervalMax = cam.rate.intervalMax();
+	sample.jitter = cam.rate.jitterMean();
+	sample.jitterP99 = cam.rate.jitterP99();
+	if (this->derivativeWindow > 0)
+		cam.derivative.add(time, D1::decode(data), this->derivativeWindow, sample.velocity, sample.acceleration);
+	cam.samples.publish();
+	cam.seen.store(true, std::memory_order_relaxed);
+	TRACE_MARK(Trace::Publish, data[D1::CAMERA_ID]);
+
+	if (((this->sendSlices && !this->multicamera) || this->keepHistory) && !this->slices.push(sample))
+		this->sliceOverflow++;
+	return true;
+}
+
+void Mailbox::trackLenzRange(Camera& cam, const uint8_t* data)
+{
+	int32_t lz = D1::lens(data, D1::Zoom);
+	int32_t lf = D1::lens(data, D1::Focus);
+
+	// zoom
+	if (cam.zoom_max == 0 || cam.zoom_max < lz)
+		cam.zoom_max = lz;
+	if (cam.zoom_min == 0 || cam.zoom_min > lz)
+		cam.zoom_min = lz;
+
+	// focus
+	if (cam.focus_max == 0 || cam.focus_max < lf)
+		cam.focus_max = lf;
+	if (cam.focus_min == 0 || cam.focus_min > lf)
+		cam.focus_min = lf;
+}
+
+SharedPort::SharedPort(const std::string& name, bool reactor) : name(name), reactor(reactor)
+{
+}
+
+SharedPort::~SharedPort()
+{
+	if (this->state == Connected)
+		this->disconnect();
+}
+
+bool SharedPort::open(const std::vector<std::string>& present)
+{
+#ifdef _WIN32
+	// search device
+	bool found = false;
+	for (const auto& p : present) {
+		if (this->name == p)
+			found = true;
+	}
+
+	// device not found
+	if (!found) {
+		return false;
+	}
+#else
+	// a device node that is gone fails to open below
+	(void)present;
+#endif
+
+	Serial::SerialConfig serialConfig = { CBR_38400, 8, ODDPARITY, ONESTOPBIT };
+
+	this->latencyApplied = this->latencyRequest;
+	this->serial.SetLatencyTimer(this->latencyApplied);
+
+	// open error
+	if (!this->serial.Open(this->name, serialConfig)) {
+		return false;
+	}
+
+	Logger::Instance().Log(Logger::Info, Logger::PortOpened, this->name.c_str());
+
+	return true;
+}
+
+bool SharedPort::start()
+{
+	this->scanner.reset();
+	this->lastFrame = 0;
+
+	if (this->reactor)
+		return Reactor::Instance().Add(this);
+
+	this->running = true;
+	this->thread = std::thread([this]() {
+		this->loop();
+	});
+	return true;
+}
+
+void SharedPort::stop()
+{
+	if (this->reactor) {
+		Reactor::Instance().Remove(this);
+		return;
+	}
+
+	// wakes the reader out of its wait, so this returns without waiting for the timeout
+	this->running = false;
+	this->serial.Interrupt();
+	if (this->thread.joinable())
+		this->thread.join();
+}
+
+WakeLatency& SharedPort::Latency()
+{
+	return this->reactor ? Reactor::Instance().Latency() : this->serial.Latency();
+}
+
+void SharedPort::loop()
+{
+	// reused for the life of the thread, nothing is allocated per packet
+	uint8_t buffer[1024];
+	Trace::NameThread("reader " + this->name);
+
+	// a reconnect starts a new thread, give it the same scheduling
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->tuningSet)
+			this->tuningApplied = applyThreadTuning(this->tuning) ? 1 : 0;
+	}
+
+	while (this->running)
+	{
+		int n = this->serial.Read(buffer, sizeof(buffer));
+		this->service(buffer, n);
+
+		if (n < 0)
+			this->serial.WaitInterrupt(100);
+	}
+}
+
+void SharedPort::service(const uint8_t* data, int n)
+{
+	int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	if (n < 0) {
+		this->failed = true;
+		this->readErrors.fetch_add(1, std::memory_order_relaxed);
+		Logger::Instance().LogAt(now, Logger::Error, Logger::ReadError, this->name.c_str());
+	}
+	if (n > 0) {
+		this->bytesReceived.fetch_add(n, std::memory_order_relaxed);
+		this->lastData = now;
+		this->gotData = true;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	// after the wait, so settings changed meanwhile apply to these bytes
+	for (Mailbox* m : this->subscribers) {
+		this->applyCommands(*m);
+	}
+
+	// id filtering is up to each subscriber, the port only checks framing
+	if (n <= 0)
+		return;
+	TRACE_SCOPE(Trace::Service, n);
+	// counters only, nothing on the reader thread writes to the console
+	uint64_t accepted = 0;
+	// frames earlier in the chunk are back-dated by the bytes that followed them
+	int64_t byteNs = (int64_t)this->serial.ByteNs();
+	this->scanner.feed(data, n,
+		[](const uint8_t* data) { return D1::isValid(data); },
+		[this, now, n, byteNs, &accepted](const uint8_t* data, size_t end) {
+			accepted++;
+			TRACE_MARK(Trace::Frame, data[D1::CAMERA_ID]);
+			int64_t time = now - (n - (int64_t)end) * byteNs;
+			if (time < this->lastFrame)
+				time = this->lastFrame;
+			if (this->lastFrame && time - this->lastFrame > GAP_NS)
+				Logger::Instance().LogAt(now, Logger::Warning, Logger::FrameGap, this->name.c_str(), (time - this->lastFrame) / 1e6);
+			this->lastFrame = time;
+			for (Mailbox* m : this->subscribers) {
+				m->Deliver(data, time);
+			}
+		});
+
+	this->framesAccepted.fetch_add(accepted, std::memory_order_relaxed);
+	this->checksumErrors.store(this->scanner.rejected, std::memory_order_relaxed);
+	this->resyncs.store(this->scanner.resyncs, std::memory_order_relaxed);
+	this->discarded.store(this->scanner.discarded, std::memory_order_relaxed);
+
+	if (this->scanner.resyncs != this->loggedResyncs) {
+		this->loggedResyncs = this->scanner.resyncs;
+		Logger::Instance().LogAt(now, Logger::Warning, Logger::Resync, this->name.c_str(), (double)this->scanner.discarded);
+	}
+}
+
+void SharedPort::applyCommands(Mailbox& mailbox)
+{
+	Command cmd;
+	while (mailbox.commands.pop(cmd)) {
+		switch (cmd.type) {
+		case Command::CameraId:
+			mailbox.cameraid = (int)cmd.values[0];
+			break;
+		case Command::ZoomReset:
+			for (auto& cam : mailbox.cameras) {
+				cam.zoom_max = 0;
+				cam.zoom_min = 0;
+			}
+			break;
+		case Command::FocusReset:
+			for (auto& cam : mailbox.cameras) {
+				cam.focus_max = 0;
+				cam.focus_min = 0;
+			}
+			break;
+		case Command::MultiCamera:
+			mailbox.multicamera = cmd.values[0] != 0.0;
+			break;
+		case Command::Timeslice:
+			mailbox.sendSlices = cmd.values[0] != 0.0;
+			break;
+		case Command::History:
+			mailbox.keepHistory = cmd.values[0] != 0.0;
+			break;
+		case Command::Derivatives:
+			// a new window starts from the next frame
+			mailbox.derivativeWindow = (int)cmd.values[0];
+			for (auto& cam : mailbox.cameras) {
+				cam.derivative.reset();
+			}
+			break;
+		case Command::InterByteTimeout:
+			// one setting per port, the last subscriber to change it wins
+			this->serial.SetInterByteTimeout((unsigned long)cmd.values[0]);
+			break;
+		case Command::SilenceTimeout:
+			this->silenceMs = (int)cmd.values[0];
+			break;
+		case Command::LatencyTimer:
+			// set by the monitor, too slow on Windows for this thread
+			this->latencyRequest = (int)cmd.values[0];
+			break;
+		case Command::Tuning:
+			// runs on the reader thread, which is the one to tune
+			this->tuning.priority = (int)cmd.values[0];
+			this->tuning.affinity = (uint64_t)cmd.values[1];
+			this->tuning.task = (int)cmd.values[2];
+			this->tuningSet = true;
+			this->tuningApplied = applyThreadTuning(this->tuning) ? 1 : 0;
+			// what follows is measured under the new setting
+			this->Latency().reset();
+			break;
+		}
+	}
+}
+
+void SharedPort::supervise(int64_t now, const std::vector<std::string>& present)
+{
+	std::unique_lock<std::mutex> lock(this->stateMutex);
+	if (this->retired)
+		return;
+
+	// a new latency timer is set while opening, which takes an enumeration
+	// and a registry write on Windows; a connected port is reopened for it
+	bool retune = false;
+	if (this->state == Connected) {
+		int silence = this->silenceMs;
+		bool silent = silence > 0 && now - this->lastData > silence * 1000000LL;
+		retune = this->latencyRequest != this->latencyApplied;
+		if (!this->failed && !silent && !retune)
+			return;
+
+		if (this->failed || silent) {
+			retune = false;
+			Logger::Instance().Log(Logger::Warning, Logger::PortLost, this->name.c_str(),
+				(double)this->readErrors.load(), (now - this->lastData) / 1e6);
+			this->disconnect();
+
+			// a port that opens but never talks backs off like one that is missing
+			if (this->gotData)
+				this->backoffMs = 0;
+			this->backoffMs = this->backoffMs ? std::min(this->backoffMs * 2, 5000) : 100;
+			this->nextAttempt = now + this->backoffMs * 1000000LL;
+			return;
+		}
+		this->disconnect();
+	}
+	else if (now < this->nextAttempt) {
+		return;
+	}
+
+	// Opening can take a while on Windows and the last unsubscribe waits
+	// for this lock on the cook thread, so it is not held meanwhile.
+	// Nothing else touches a waiting port's serial; only this thread
+	// opens, and an unsubscribe meanwhile just retires the port.
+	lock.unlock();
+	bool opened = this->open(present);
+	lock.lock();
+
+	if (opened && this->retired) {
+		this->serial.Close();
+		return;
+	}
+	if (opened) {
+		this->failed = false;
+		this->gotData = false;
+		this->lastData = now;
+		if (this->start()) {
+			if (this->everConnected && !retune)
+				this->reconnects++;
+			this->everConnected = true;
+			this->state = Connected;
+			return;
+		}
+		this->serial.Close();
+	}
+	if (this->retired)
+		return;
+
+	this->backoffMs = this->backoffMs ? std::min(this->backoffMs * 2, 5000) : 100;
+	this->nextAttempt = now + this->backoffMs * 1000000LL;
+	Logger::Instance().Log(Logger::Info, Logger::OpenFailed, this->name.c_str(), (double)this->backoffMs);
+}
+
+void SharedPort::disconnect()
+{
+	this->stop();
+	this->serial.Close();
+	this->state = Waiting;
+}
+
+PortRegistry::~PortRegistry()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->monitorStop = true;
+	}
+	this->monitorWake.notify_all();
+	if (this->monitor.joinable())
+		this->monitor.join();
+}
+
+PortRegistry& PortRegistry::Instance()
+{
+	static PortRegistry registry;
+	return registry;
+}
+
+std::shared_ptr<SharedPort> PortRegistry::Subscribe(const std::string& name, Mailbox* mailbox, bool reactor)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	std::shared_ptr<SharedPort> port;
+	auto it = this->ports.find(name);
+	if (it != this->ports.end()) {
+		port = it->second;
+	}
+	else {
+		port = std::make_shared<SharedPort>(name, reactor);
+		this->ports[name] = port;
+	}
+
+	{
+		std::lock_guard<std::mutex> portLock(port->mutex);
+		port->subscribers.push_back(mailbox);
+	}
+
+	if (!this->monitorRunning) {
+		// the previous monitor has left its loop already
+		if (this->monitor.joinable())
+			this->monitor.join();
+		this->monitorRunning = true;
+		this->monitor = std::thread([this]() {
+			this->monitorLoop();
+		});
+	}
+	this->monitorWake.notify_all();
+	return port;
+}
+
+void PortRegistry::Unsubscribe(const std::shared_ptr<SharedPort>& port, Mailbox* mailbox)
+{
+	if (!port)
+		return;
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	bool last;
+	{
+		std::lock_guard<std::mutex> portLock(port->mutex);
+		auto& subs = port->subscribers;
+		subs.erase(std::remove(subs.begin(), subs.end(), mailbox), subs.end());
+		last = subs.empty();
+	}
+
+	if (last) {
+		auto it = this->ports.find(port->Name());
+		if (it != this->ports.end() && it->second == port)
+			this->ports.erase(it);
+
+		std::lock_guard<std::mutex> stateLock(port->stateMutex);
+		port->retired = true;
+		if (port->state == SharedPort::Connected)
+			port->disconnect();
+	}
+}
+
+void PortRegistry::monitorLoop()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	while (!this->monitorStop && !this->ports.empty())
+	{
+		int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+
+		std::vector<std::shared_ptr<SharedPort>> snapshot;
+		bool waiting = false;
+		for (auto& p : this->ports) {
+			snapshot.push_back(p.second);
+			waiting |= p.second->GetState() != SharedPort::Connected;
+		}
+
+		lock.unlock();
+
+		// enumeration is slow on Windows, only redone while a port is missing
+		if (waiting && now - this->presentTime > 1000000000LL) {
+			this->present = getSerialList();
+			this->presentTime = now;
+		}
+		for (auto& p : snapshot) {
+			p->supervise(now, this->present);
+		}
+		snapshot.clear();
+
+		lock.lock();
+		this->monitorWake.wait_for(lock, std::chrono::milliseconds(50));
+	}
+
+	this->monitorRunning = false;
+}
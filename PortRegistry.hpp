@@ -0,0 +1,216 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Serial.hpp"
+#include "LockFree.hpp"
+#include "D1Packet.hpp"
+#include "D1Scanner.hpp"
+#include "Derivative.hpp"
+#include "RateStats.hpp"
+#include "ThreadTuning.hpp"
+
+// an accepted frame as the receiver stores it, decoded at cook time
+struct Sample {
+	uint8_t frame[D1::FRAME];
+	int64_t time;	// steady_clock ns at the frame's last byte
+	int32_t zoom_min, zoom_max;
+	int32_t focus_min, focus_max;
+	// RateStats of the camera at this frame, rates in Hz, times in ms
+	double fps, fpsavg;
+	double interval, intervalMin, intervalMax;
+	double jitter, jitterP99;
+	// per s and per s^2 of tx ... focus, raw lens units; only filled while
+	// the mailbox asks for derivatives
+	double velocity[TimedPose::VALUES];
+	double acceleration[TimedPose::VALUES];
+};
+
+// per camera id state on the port
+struct Camera {
+	// raw lens ranges, tracked by the receiver on every frame
+	int32_t zoom_max = 0;
+	int32_t zoom_min = 0;
+	int32_t focus_max = 0;
+	int32_t focus_min = 0;
+
+	RateStats rate;
+	Differentiator derivative;
+
+	// receiver -> cook
+	std::atomic<bool> seen{ false };
+	TripleBuffer<Sample> samples;
+};
+
+struct Command {
+	enum Type { CameraId, ZoomReset, FocusReset, Timeslice, InterByteTimeout, MultiCamera, SilenceTimeout, Tuning, LatencyTimer, History, Derivatives };
+	Type type;
+	double values[3];
+};
+
+// One subscriber of a shared port, usually one CHOP node.
+// Everything but the command queue is written by the port thread only,
+// the node reads it through the lock-free buffers.
+class Mailbox {
+public:
+	// receiver side settings, changed through commands
+	int cameraid = 0;
+	bool multicamera = false;
+	bool sendSlices = false;
+	// the node keeps a pose history and needs every frame, in any mode
+	bool keepHistory = false;
+	// frames per derivative fit, 0 for none
+	int derivativeWindow = 0;
+
+	std::array<Camera, 256> cameras;
+
+	// every packet since the last cook, only filled in timeslice mode or
+	// for the node's pose history
+	SpscQueue<Sample, 256> slices;
+	std::atomic<uint64_t> sliceOverflow{ 0 };
+	std::atomic<uint64_t> packets{ 0 };
+	// frames for other camera ids in single camera mode, and the last such id
+	std::atomic<uint64_t> idMismatches{ 0 };
+	std::atomic<int> lastOtherId{ -1 };
+
+	// node -> port thread
+	SpscQueue<Command, 64> commands;
+
+	// port thread, false when the frame is for a camera id this subscriber ignores
+	bool Deliver(const uint8_t* data, int64_t time);
+
+private:
+	void trackLenzRange(Camera& cam, const uint8_t* data);
+};
+
+// One physical port: a single reader and parser that hands every valid
+// frame to all subscribed mailboxes. The reader is either a thread of its
+// own or the process wide Reactor. Opening, loss detection and reconnects
+// are done by the registry's monitor thread.
+class SharedPort {
+public:
+	enum State { Waiting = 1, Connected = 2 };
+
+	SharedPort(const std::string& name, bool reactor);
+	~SharedPort();
+
+	const std::string& Name() const { return name; }
+	bool UsesReactor() const { return reactor; }
+	int GetState() const { return state; }
+	unsigned long long Reconnects() const { return reconnects; }
+	unsigned long long Wakeups() { return serial.Wakeups(); }
+	double BacklogAvg() { return serial.BacklogAvg(); }
+	double BacklogMax() { return serial.BacklogMax(); }
+	// how late the reader thread wakes from its timed waits, in reactor
+	// mode the reactor thread; restarts when the tuning changes
+	WakeLatency& Latency();
+	int LatencyTimer() { return serial.LatencyTimer(); }
+
+	// link health, written by the reader only
+	std::atomic<uint64_t> bytesReceived{ 0 };
+	std::atomic<uint64_t> framesAccepted{ 0 };
+	std::atomic<uint64_t> checksumErrors{ 0 };
+	std::atomic<uint64_t> resyncs{ 0 };
+	std::atomic<uint64_t> discarded{ 0 };
+	std::atomic<uint64_t> readErrors{ 0 };
+	// frames further apart than this are logged
+	static const int64_t GAP_NS = 50000000;
+	// 1 when the reader thread got the requested scheduling, 0 if refused, -1 not yet applied
+	int TuningApplied() const { return tuningApplied; }
+
+private:
+	friend class PortRegistry;
+	friend class Reactor;
+
+	std::string name;
+	bool reactor;
+	Serial serial;
+	D1Scanner scanner;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	// reader thread scheduling, last subscriber to change it wins.
+	// In reactor mode it applies to the shared reactor thread.
+	ThreadTuning tuning;
+	bool tuningSet = false;
+	std::atomic<int> tuningApplied{ -1 };
+
+	// taken by the port thread once per read chunk and by subscribe/unsubscribe,
+	// never by a cook
+	std::mutex mutex;
+	std::vector<Mailbox*> subscribers;
+
+	// monitor thread and the last unsubscribe, serializes starting and closing;
+	// the monitor drops it while the device itself is opened
+	std::mutex stateMutex;
+	bool retired = false;
+	std::atomic<int> state{ Waiting };
+	std::atomic<unsigned long long> reconnects{ 0 };
+	int64_t nextAttempt = 0;
+	int backoffMs = 0;
+	bool everConnected = false;
+
+	// reported by the reader, checked by the monitor
+	std::atomic<int64_t> lastData{ 0 };
+	std::atomic<bool> gotData{ false };
+	std::atomic<bool> failed{ false };
+	std::atomic<int> silenceMs{ 2000 };
+	// USB latency timer asked for by a subscriber, and what the monitor
+	// last opened the port with
+	std::atomic<int> latencyRequest{ 0 };
+	int latencyApplied = 0;
+
+	// reader only
+	int64_t lastFrame = 0;
+	uint64_t loggedResyncs = 0;
+
+	bool open(const std::vector<std::string>& present);
+	bool start();
+	void stop();
+	void supervise(int64_t now, const std::vector<std::string>& present);
+	void disconnect();
+	void loop();
+	// n bytes read at one wakeup, 0 to only apply commands, -1 on a read error
+	void service(const uint8_t* data, int n);
+	void applyCommands(Mailbox& mailbox);
+};
+
+// Process wide, keyed by port name. Subscribing never touches the device:
+// a monitor thread opens new ports, keeps a cached port list, notices lost
+// ports (read errors or silence) and reconnects them with exponential
+// backoff. The last unsubscribe closes the port.
+class PortRegistry {
+public:
+	static PortRegistry& Instance();
+
+	PortRegistry() = default;
+	PortRegistry(const PortRegistry&) = delete;
+	~PortRegistry();
+
+	// an already known port keeps the I/O mode it was first subscribed with
+	std::shared_ptr<SharedPort> Subscribe(const std::string& name, Mailbox* mailbox, bool reactor);
+	void Unsubscribe(const std::shared_ptr<SharedPort>& port, Mailbox* mailbox);
+
+private:
+	std::mutex mutex;
+	std::map<std::string, std::shared_ptr<SharedPort>> ports;
+
+	// runs while there are ports
+	std::thread monitor;
+	bool monitorRunning = false;
+	bool monitorStop = false;
+	std::condition_variable monitorWake;
+	std::vector<std::string> present;
+	int64_t presentTime = 0;
+
+	void monitorLoop();
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "D1Packet.hpp"
+
+// a decoded pose with the time its frame arrived
+struct TimedPose {
+	// tx, ty, tz, rx, ry, rz, zoom, focus in D1::Pose units
+	static const size_t VALUES = 8;
+	int64_t time;	// steady_clock ns
+	double v[VALUES];
+
+	static bool isAngle(size_t i) { return i >= 3 && i < 6; }
+
+	D1::Pose pose() const {
+		return { v[0], v[1], v[2], v[3], v[4], v[5], (int32_t)std::lround(v[6]), (int32_t)std::lround(v[7]) };
+	}
+};
+
+// shortest signed difference between two angles in deg, handles the +-180 wrap
+inline double angleDelta(double from, double to) {
+	return std::remainder(to - from, 360.0);
+}
+
+// Unit quaternion of a camera head orientation: pan about y, then tilt
+// about x, then roll about z (R = Ry * Rx * Rz), angles in deg as rx, ry, rz.
+struct Quat {
+	double w, x, y, z;
+
+	static Quat fromEuler(double rx, double ry, double rz) {
+		const double h = 3.14159265358979323846 / 360.0;
+		double c1 = std::cos(rx * h), s1 = std::sin(rx * h);
+		double c2 = std::cos(ry * h), s2 = std::sin(ry * h);
+		double c3 = std::cos(rz * h), s3 = std::sin(rz * h);
+		return {
+			c1 * c2 * c3 + s1 * s2 * s3,
+			s1 * c2 * c3 + c1 * s2 * s3,
+			c1 * s2 * c3 - s1 * c2 * s3,
+			c1 * c2 * s3 - s1 * s2 * c3,
+		};
+	}
+
+	void toEuler(double& rx, double& ry, double& rz) const {
+		const double d = 180.0 / 3.14159265358979323846;
+		double sx = 2.0 * (w * x - y * z);
+		rx = std::asin(sx > 1.0 ? 1.0 : sx < -1.0 ? -1.0 : sx) * d;
+		ry = std::atan2(2.0 * (x * z + w * y), 1.0 - 2.0 * (x * x + y * y)) * d;
+		rz = std::atan2(2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z)) * d;
+	}
+
+	// The angles nearest to ref (rx, ry, rz) that give this rotation: of
+	// the two equivalent triples the closer one, each angle unwrapped to
+	// within 180 deg of ref, so the result follows the track ref is on.
+	void toEuler(double* v, const double* ref) const {
+		double a[3], b[3];
+		this->toEuler(a[0], a[1], a[2]);
+		// R = Ry(ry + 180) * Rx(180 - rx) * Rz(rz + 180) as well
+		b[0] = 180.0 - a[0];
+		b[1] = a[1] + 180.0;
+		b[2] = a[2] + 180.0;
+		double da = 0.0, db = 0.0;
+		for (int k = 0; k < 3; k++) {
+			a[k] = ref[k] + angleDelta(ref[k], a[k]);
+			b[k] = ref[k] + angleDelta(ref[k], b[k]);
+			da += (a[k] - ref[k]) * (a[k] - ref[k]);
+			db += (b[k] - ref[k]) * (b[k] - ref[k]);
+		}
+		const double* best = da <= db ? a : b;
+		for (int k = 0; k < 3; k++)
+			v[k] = best[k];
+	}
+
+	// constant angular velocity path from a (u = 0) to b (u = 1), the short way
+	static Quat slerp(const Quat& a, Quat b, double u) {
+		double dot = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+		if (dot < 0.0) {
+			b = { -b.w, -b.x, -b.y, -b.z };
+			dot = -dot;
+		}
+		double ka = 1.0 - u, kb = u;
+		if (dot < 0.9995) {
+			double theta = std::acos(dot);
+			double s = std::sin(theta);
+			ka = std::sin(ka * theta) / s;
+			kb = std::sin(kb * theta) / s;
+		}
+		Quat q{ ka * a.w + kb * b.w, ka * a.x + kb * b.x, ka * a.y + kb * b.y, ka * a.z + kb * b.z };
+		double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+		return { q.w / n, q.x / n, q.y / n, q.z / n };
+	}
+};
+
+// Cook side history of one camera, fed with every frame the node drained
+// since its last cook. Fixed capacity, the oldest entries are overwritten.
+class PoseHistory {
+public:
+	static const size_t CAPACITY = 256;
+
+	void clear() { count = 0; }
+
+	void push(int64_t time, const D1::Pose& p) {
+		TimedPose& e = entries[(head + count) % CAPACITY];
+		e = { time, { p.tx, p.ty, p.tz, p.rx, p.ry, p.rz, (double)p.zoom, (double)p.focus } };
+		if (count < CAPACITY)
+			count++;
+		else
+			head = (head + 1) % CAPACITY;
+	}
+
+	size_t size() const { return count; }
+	// 0 is the oldest
+	const TimedPose& operator[](size_t i) const { return entries[(head + i) % CAPACITY]; }
+	const TimedPose& back() const { return (*this)[count - 1]; }
+
+	// index of the first entry at or after t, size() if there is none; O(log n)
+	size_t lowerBound(int64_t t) const {
+		size_t lo = 0;
+		size_t hi = count;
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if ((*this)[mid].time < t)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	// the pose at t, linear between the neighbouring entries, angles the
+	// short way round; false when t is outside the history
+	bool interpolate(int64_t t, TimedPose& out) const {
+		size_t i = lowerBound(t);
+		if (i == count || (i == 0 && (*this)[0].time != t))
+			return false;
+		const TimedPose& b = (*this)[i];
+		if (b.time == t) {
+			out = b;
+			return true;
+		}
+		const TimedPose& a = (*this)[i - 1];
+		double u = (double)(t - a.time) / (double)(b.time - a.time);
+		out.time = t;
+		for (size_t k = 0; k < TimedPose::VALUES; k++) {
+			if (TimedPose::isAngle(k))
+				out.v[k] = std::remainder(a.v[k] + angleDelta(a.v[k], b.v[k]) * u, 360.0);
+			else
+				out.v[k] = a.v[k] + (b.v[k] - a.v[k]) * u;
+		}
+		return true;
+	}
+
+	// The pose at t for a delayed output, clamped to the history. Position
+	// and lens follow a cubic Hermite curve with Catmull-Rom tangents from
+	// the neighbouring entries (hermite) or a straight line, the rotation
+	// is slerped. Angles keep the winding of the entries, so the output
+	// continues the undelayed one across +-180. False when the history is
+	// empty.
+	bool sample(int64_t t, bool hermite, TimedPose& out) const {
+		if (count == 0)
+			return false;
+		size_t i = lowerBound(t);
+		if (i == count || (*this)[i].time == t || i == 0) {
+			out = (*this)[i == count ? count - 1 : i];
+			out.time = t;
+			return true;
+		}
+
+		const TimedPose& a = (*this)[i - 1];
+		const TimedPose& b = (*this)[i];
+		double h = (b.time - a.time) / 1e9;
+		double u = (t - a.time) / 1e9 / h;
+		out.time = t;
+
+		// tangents in units per s, one-sided at the ends of the history
+		const TimedPose& p = i >= 2 ? (*this)[i - 2] : a;
+		const TimedPose& n = i + 1 < count ? (*this)[i + 1] : b;
+		double tp = (b.time - p.time) / 1e9;
+		double tn = (n.time - a.time) / 1e9;
+		double h00 = (1.0 + 2.0 * u) * (1.0 - u) * (1.0 - u);
+		double h10 = u * (1.0 - u) * (1.0 - u);
+		double h01 = u * u * (3.0 - 2.0 * u);
+		double h11 = u * u * (u - 1.0);
+		for (size_t k = 0; k < TimedPose::VALUES; k++) {
+			if (TimedPose::isAngle(k))
+				continue;
+			if (!hermite) {
+				out.v[k] = a.v[k] + (b.v[k] - a.v[k]) * u;
+				continue;
+			}
+			double ma = (b.v[k] - p.v[k]) / tp;
+			double mb = (n.v[k] - a.v[k]) / tn;
+			out.v[k] = h00 * a.v[k] + h10 * h * ma + h01 * b.v[k] + h11 * h * mb;
+		}
+
+		// unwrapped against the entries interpolated angle by angle
+		double ref[3];
+		for (size_t k = 0; k < 3; k++)
+			ref[k] = a.v[3 + k] + angleDelta(a.v[3 + k], b.v[3 + k]) * u;
+		Quat q = Quat::slerp(Quat::fromEuler(a.v[3], a.v[4], a.v[5]), Quat::fromEuler(b.v[3], b.v[4], b.v[5]), u);
+		q.toEuler(out.v + 3, ref);
+		return true;
+	}
+
+	// [from, to] of an exposure of span ns that ends at end, moved back to
+	// end at the newest entry at the latest, since nothing is known past
+	// it yet. False when the history is empty.
+	bool exposure(int64_t end, int64_t span, int64_t& from, int64_t& to) const {
+		if (count == 0)
+			return false;
+		to = end < back().time ? end : back().time;
+		from = to - span;
+		return true;
+	}
+
+	// Time average of the pose over [from, to], e.g. a shutter interval:
+	// trapezoids between the window edges and every entry inside it, the
+	// rotation as the normalized weighted sum of its quaternions, its
+	// angles wound like the entries.
+	bool mean(int64_t from, int64_t to, bool hermite, TimedPose& out) const {
+		if (count == 0)
+			return false;
+		if (to <= from)
+			return sample(to, hermite, out);
+
+		TimedPose prev;
+		sample(from, hermite, prev);
+		double sum[TimedPose::VALUES] = {};
+		Quat q0 = Quat::fromEuler(prev.v[3], prev.v[4], prev.v[5]);
+		Quat qsum{ 0.0, 0.0, 0.0, 0.0 };
+		Quat qprev = q0;
+		// the angles unwrapped along the way and their average, to unwrap against
+		double angle[3] = { prev.v[3], prev.v[4], prev.v[5] };
+		double asum[3] = {};
+
+		for (size_t i = lowerBound(from + 1); ; i++) {
+			TimedPose next;
+			if (i < count && (*this)[i].time < to)
+				next = (*this)[i];
+			else
+				sample(to, hermite, next);
+
+			double w = (next.time - prev.time) / 2.0;
+			for (size_t k = 0; k < TimedPose::VALUES; k++) {
+				if (!TimedPose::isAngle(k))
+					sum[k] += (prev.v[k] + next.v[k]) * w;
+			}
+			for (size_t k = 0; k < 3; k++) {
+				double a = angle[k] + angleDelta(angle[k], next.v[3 + k]);
+				asum[k] += (angle[k] + a) * w;
+				angle[k] = a;
+			}
+			// same hemisphere as the first, so opposite signs don't cancel
+			Quat q = Quat::fromEuler(next.v[3], next.v[4], next.v[5]);
+			if (q.w * q0.w + q.x * q0.x + q.y * q0.y + q.z * q0.z < 0.0)
+				q = { -q.w, -q.x, -q.y, -q.z };
+			qsum = { qsum.w + (qprev.w + q.w) * w, qsum.x + (qprev.x + q.x) * w,
+				qsum.y + (qprev.y + q.y) * w, qsum.z + (qprev.z + q.z) * w };
+
+			prev = next;
+			qprev = q;
+			if (next.time >= to)
+				break;
+		}
+
+		double span = (double)(to - from);
+		out.time = to;
+		for (size_t k = 0; k < TimedPose::VALUES; k++) {
+			if (!TimedPose::isAngle(k))
+				out.v[k] = sum[k] / span;
+		}
+		double n = std::sqrt(qsum.w * qsum.w + qsum.x * qsum.x + qsum.y * qsum.y + qsum.z * qsum.z);
+		Quat q{ qsum.w / n, qsum.x / n, qsum.y / n, qsum.z / n };
+		double ref[3] = { asum[0] / span, asum[1] / span, asum[2] / span };
+		q.toEuler(out.v + 3, ref);
+		return true;
+	}
+
+private:
+	TimedPose entries[CAPACITY];
+	size_t head = 0;
+	size_t count = 0;
+};
@@ -0,0 +1,217 @@
+#include "Predictor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Kalman tuning per value: measurement noise from the D1 resolution,
+// acceleration noise from how hard a tracked camera head moves
+static double measureSigma(size_t i)
+{
+	if (i < 3)
+		return 1e-4;	// m
+	if (i < 6)
+		return 5e-4;	// deg
+	return 1.0;			// raw lens
+}
+
+static double accelSigma(size_t i)
+{
+	if (i < 3)
+		return 2.0;		// m/s^2
+	if (i < 6)
+		return 200.0;	// deg/s^2
+	return 5e4;
+}
+
+// a reconnect or a long dropout starts the filter over
+static const int64_t FILTER_GAP_NS = 500000000;
+
+void Predictor::reset()
+{
+	this->filterValid = false;
+	this->filterTime = 0;
+	this->pendingCount = 0;
+	this->errorCount = 0;
+	this->sumMm = 0.0;
+	this->sumDeg = 0.0;
+	this->lastErrorMm = 0.0;
+	this->lastErrorDeg = 0.0;
+}
+
+void Predictor::update(const PoseHistory& history, double noise)
+{
+	if (history.size() == 0)
+		return;
+
+	size_t i = this->filterValid ? history.lowerBound(this->filterTime + 1) : 0;
+	for (; i < history.size(); i++) {
+		this->filter(history[i], noise);
+	}
+	this->score(history);
+}
+
+void Predictor::filter(const TimedPose& z, double noise)
+{
+	int64_t gap = z.time - this->filterTime;
+	if (!this->filterValid || gap > FILTER_GAP_NS || gap < 0) {
+		for (size_t i = 0; i < TimedPose::VALUES; i++) {
+			double r = measureSigma(i) * measureSigma(i);
+			double a = accelSigma(i);
+			this->filters[i] = { z.v[i], 0.0, r, 0.0, a * a };
+		}
+		this->filterTime = z.time;
+		this->filterValid = true;
+		return;
+	}
+
+	double dt = gap / 1e9;
+	for (size_t i = 0; i < TimedPose::VALUES; i++) {
+		Filter& f = this->filters[i];
+		double q = accelSigma(i) * accelSigma(i) * noise;
+		double r = measureSigma(i) * measureSigma(i);
+
+		// predict, white acceleration noise
+		f.x += f.v * dt;
+		f.p00 += dt * (2.0 * f.p01 + dt * f.p11) + q * dt * dt * dt / 3.0;
+		f.p01 += dt * f.p11 + q * dt * dt / 2.0;
+		f.p11 += q * dt;
+
+		// correct with the measured value
+		double y = TimedPose::isAngle(i) ? angleDelta(f.x, z.v[i]) : z.v[i] - f.x;
+		double s = f.p00 + r;
+		double k0 = f.p00 / s;
+		double k1 = f.p01 / s;
+		f.x += k0 * y;
+		f.v += k1 * y;
+		if (TimedPose::isAngle(i))
+			f.x = std::remainder(f.x, 360.0);
+		double p00 = f.p00, p01 = f.p01;
+		f.p00 -= k0 * p00;
+		f.p01 -= k0 * p01;
+		f.p11 -= k1 * p01;
+	}
+	this->filterTime = z.time;
+}
+
+bool Predictor::predict(const PoseHistory& history, int model, int64_t target, TimedPose& out)
+{
+	size_t n = history.size();
+	if (n == 0)
+		return false;
+	const TimedPose& c = history.back();
+	out.time = target;
+
+	switch (model) {
+	case ConstantVelocity: {
+		if (n < 2)
+			return false;
+		const TimedPose& b = history[n - 2];
+		if (c.time <= b.time)
+			return false;
+		double u = (double)(target - c.time) / (double)(c.time - b.time);
+		for (size_t i = 0; i < TimedPose::VALUES; i++) {
+			double d = TimedPose::isAngle(i) ? angleDelta(b.v[i], c.v[i]) : c.v[i] - b.v[i];
+			out.v[i] = c.v[i] + d * u;
+		}
+		break;
+	}
+	case ConstantAcceleration: {
+		if (n < 3)
+			return false;
+		const TimedPose& a = history[n - 3];
+		const TimedPose& b = history[n - 2];
+		if (c.time <= b.time || b.time <= a.time)
+			return false;
+		// parabola through the last three frames, Newton form around the newest,
+		// times in s relative to it and angles unwrapped towards it
+		double ta = (a.time - c.time) / 1e9;
+		double tb = (b.time - c.time) / 1e9;
+		double t = (target - c.time) / 1e9;
+		for (size_t i = 0; i < TimedPose::VALUES; i++) {
+			bool angle = TimedPose::isAngle(i);
+			double ya = angle ? c.v[i] - angleDelta(a.v[i], c.v[i]) : a.v[i];
+			double yb = angle ? c.v[i] - angleDelta(b.v[i], c.v[i]) : b.v[i];
+			double fbc = (c.v[i] - yb) / -tb;
+			double fab = (yb - ya) / (tb - ta);
+			double fabc = (fbc - fab) / -ta;
+			out.v[i] = c.v[i] + fbc * t + fabc * t * (t - tb);
+		}
+		break;
+	}
+	case Kalman: {
+		if (!this->filterValid)
+			return false;
+		double dt = (target - this->filterTime) / 1e9;
+		for (size_t i = 0; i < TimedPose::VALUES; i++) {
+			out.v[i] = this->filters[i].x + this->filters[i].v * dt;
+		}
+		break;
+	}
+	default:
+		return false;
+	}
+
+	for (size_t i = 3; i < 6; i++) {
+		out.v[i] = std::remainder(out.v[i], 360.0);
+	}
+
+	// scored once the history reaches the target, the oldest goes when full
+	if (this->pendingCount == PENDING) {
+		this->pendingHead = (this->pendingHead + 1) % PENDING;
+		this->pendingCount--;
+	}
+	this->pending[(this->pendingHead + this->pendingCount) % PENDING] = out;
+	this->pendingCount++;
+	return true;
+}
+
+void Predictor::score(const PoseHistory& history)
+{
+	int64_t newest = history.back().time;
+	while (this->pendingCount > 0) {
+		const TimedPose& p = this->pending[this->pendingHead];
+		if (p.time > newest)
+			break;
+
+		TimedPose real;
+		if (history.interpolate(p.time, real)) {
+			double d2 = 0.0;
+			for (size_t i = 0; i < 3; i++) {
+				d2 += (p.v[i] - real.v[i]) * (p.v[i] - real.v[i]);
+			}
+			double deg = 0.0;
+			for (size_t i = 3; i < 6; i++) {
+				deg = std::max(deg, std::fabs(angleDelta(real.v[i], p.v[i])));
+			}
+			this->lastErrorMm = std::sqrt(d2) * 1000.0;
+			this->lastErrorDeg = deg;
+
+			double mm2 = this->lastErrorMm * this->lastErrorMm;
+			double deg2 = deg * deg;
+			if (this->errorCount == ERRORS) {
+				this->sumMm -= this->errorsMm[this->errorNext];
+				this->sumDeg -= this->errorsDeg[this->errorNext];
+			}
+			else
+				this->errorCount++;
+			this->errorsMm[this->errorNext] = mm2;
+			this->errorsDeg[this->errorNext] = deg2;
+			this->errorNext = (this->errorNext + 1) % ERRORS;
+			this->sumMm += mm2;
+			this->sumDeg += deg2;
+		}
+
+		this->pendingHead = (this->pendingHead + 1) % PENDING;
+		this->pendingCount--;
+	}
+}
+
+double Predictor::rmsMm() const
+{
+	return this->errorCount ? std::sqrt(std::max(this->sumMm, 0.0) / this->errorCount) : 0.0;
+}
+
+double Predictor::rmsDeg() const
+{
+	return this->errorCount ? std::sqrt(std::max(this->sumDeg, 0.0) / this->errorCount) : 0.0;
+}
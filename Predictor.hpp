@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "PoseHistory.hpp"
+
+// Extrapolates one camera's pose from its history to a later time, to make
+// up for the latency of the video path. Every prediction handed out is
+// kept until the history reaches its target time and then scored against
+// the real pose there, which is what the lead should be tuned on.
+class Predictor {
+public:
+	enum Model { Off, ConstantVelocity, ConstantAcceleration, Kalman };
+
+	void reset();
+
+	// Takes in the entries added to the history since the last call: feeds
+	// them to the Kalman filter and scores the predictions they resolve.
+	// noise scales the filter's process noise, higher follows faster.
+	void update(const PoseHistory& history, double noise);
+
+	// pose at target, false if the history is too short for the model
+	bool predict(const PoseHistory& history, int model, int64_t target, TimedPose& out);
+
+	// error of the latest scored prediction and the rms of the last ERRORS
+	double errorMm() const { return lastErrorMm; }
+	double errorDeg() const { return lastErrorDeg; }
+	double rmsMm() const;
+	double rmsDeg() const;
+
+private:
+	static const size_t PENDING = 64;
+	static const size_t ERRORS = 64;
+
+	// per value constant velocity filter
+	struct Filter {
+		double x, v;
+		double p00, p01, p11;
+	};
+	Filter filters[TimedPose::VALUES];
+	int64_t filterTime = 0;
+	bool filterValid = false;
+
+	// predictions waiting for the history to catch up, oldest first
+	TimedPose pending[PENDING];
+	size_t pendingHead = 0;
+	size_t pendingCount = 0;
+
+	// squared errors of the last scored predictions
+	double errorsMm[ERRORS];
+	double errorsDeg[ERRORS];
+	size_t errorCount = 0;
+	size_t errorNext = 0;
+	double sumMm = 0.0;
+	double sumDeg = 0.0;
+	double lastErrorMm = 0.0;
+	double lastErrorDeg = 0.0;
+
+	void filter(const TimedPose& z, double noise);
+	void score(const PoseHistory& history);
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Frame cadence from monotonic timestamps, over the last WINDOW intervals.
+// Every add() is O(1): running sums over fixed rings, monotonic queues for
+// the window min/max and a histogram of the jitter for its 99th percentile.
+// Jitter is the change between consecutive intervals, |i(n) - i(n-1)|.
+class RateStats {
+public:
+	static const size_t WINDOW = 64;	// about a second at 50-60 Hz
+	static const size_t LONG = 512;		// about ten seconds, for the average rate
+	// jitter histogram, 10 us bins up to 5.12 ms, the last bin takes the rest
+	static const size_t BINS = 512;
+	static const int64_t BIN_NS = 10000;
+
+	RateStats() { reset(); }
+
+	void reset() {
+		memset(this, 0, sizeof(*this));
+	}
+
+	// t in steady clock ns, never decreasing
+	void add(int64_t t) {
+		if (this->stamps++ == 0) {
+			this->last = t;
+			return;
+		}
+		int64_t interval = t - this->last;
+		this->last = t;
+		uint64_t n = this->seq++;
+
+		push(this->intervals, n % WINDOW, this->count, WINDOW, this->sum, interval);
+		push(this->longIntervals, n % LONG, this->longCount, LONG, this->longSum, interval);
+		slide(this->minQ, this->minHead, this->minLen, n, interval, false);
+		slide(this->maxQ, this->maxHead, this->maxLen, n, interval, true);
+
+		if (n > 0) {
+			int64_t j = interval - this->prevInterval;
+			if (j < 0)
+				j = -j;
+			size_t at = (n - 1) % WINDOW;
+			if (this->jitterCount == WINDOW)
+				this->hist[bin(this->jitters[at])]--;
+			push(this->jitters, at, this->jitterCount, WINDOW, this->jitterSum, j);
+			this->hist[bin(j)]++;
+		}
+		this->prevInterval = interval;
+	}
+
+	// Hz over the short and the long window
+	double rate() const { return this->sum ? this->count * 1e9 / this->sum : 0.0; }
+	double rateLong() const { return this->longSum ? this->longCount * 1e9 / this->longSum : 0.0; }
+
+	// ms
+	double intervalMean() const { return this->count ? this->sum / 1e6 / this->count : 0.0; }
+	double intervalMin() const { return this->minLen ? this->minQ[this->minHead].value / 1e6 : 0.0; }
+	double intervalMax() const { return this->maxLen ? this->maxQ[this->maxHead].value / 1e6 : 0.0; }
+	double jitterMean() const { return this->jitterCount ? this->jitterSum / 1e6 / this->jitterCount : 0.0; }
+	// upper edge of the bin holding the 99th percentile, searched from the top
+	// where it usually is
+	double jitterP99() const {
+		if (this->jitterCount == 0)
+			return 0.0;
+		size_t above = this->jitterCount / 100 + 1;
+		size_t seen = 0;
+		size_t i = BINS;
+		for (; i > 0; i--) {
+			seen += this->hist[i];
+			if (seen >= above)
+				break;
+		}
+		return (i + 1) * BIN_NS / 1e6;
+	}
+
+private:
+	struct Entry {
+		uint64_t seq;
+		int64_t value;
+	};
+
+	uint64_t stamps;
+	int64_t last;
+	int64_t prevInterval;
+	// intervals seen so far
+	uint64_t seq;
+
+	int64_t intervals[WINDOW];
+	size_t count;
+	int64_t sum;
+
+	int64_t longIntervals[LONG];
+	size_t longCount;
+	int64_t longSum;
+
+	// ring deques of (seq, interval), increasing for the min, decreasing for the max
+	Entry minQ[WINDOW];
+	size_t minHead, minLen;
+	Entry maxQ[WINDOW];
+	size_t maxHead, maxLen;
+
+	int64_t jitters[WINDOW];
+	size_t jitterCount;
+	int64_t jitterSum;
+	uint16_t hist[BINS + 1];
+
+	static size_t bin(int64_t j) {
+		return j / BIN_NS < (int64_t)BINS ? (size_t)(j / BIN_NS) : BINS;
+	}
+
+	static void push(int64_t* ring, size_t at, size_t& n, size_t size, int64_t& total, int64_t v) {
+		if (n == size)
+			total -= ring[at];
+		else
+			n++;
+		ring[at] = v;
+		total += v;
+	}
+
+	static void slide(Entry* q, size_t& head, size_t& len, uint64_t n, int64_t v, bool max) {
+		// drop what left the window at the front, what the new value dominates at the back
+		while (len && q[head].seq + WINDOW <= n) {
+			head = (head + 1) % WINDOW;
+			len--;
+		}
+		while (len) {
+			const Entry& back = q[(head + len - 1) % WINDOW];
+			if (max ? back.value > v : back.value < v)
+				break;
+			len--;
+		}
+		q[(head + len) % WINDOW] = { n, v };
+		len++;
+	}
+};
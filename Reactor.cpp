@@ -0,0 +1,280 @@
+#include "Reactor.hpp"
+#include "PortRegistry.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+// ports without traffic still get their commands applied this often
+#define TICK_MS 100
+// the longest single wait, each one that runs out is a latency sample
+#define PROBE_MS 10
+
+static int64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Reactor::Entry {
+	SharedPort* port;
+	bool failed = false;
+#ifdef _WIN32
+	// a read is in flight, the entry lives until its completion is dequeued
+	OVERLAPPED ov;
+	bool pending = false;
+	bool removed = false;
+	uint8_t buffer[1024];
+#endif
+};
+
+Reactor& Reactor::Instance()
+{
+	static Reactor reactor;
+	return reactor;
+}
+
+#ifdef _WIN32
+
+Reactor::Reactor()
+{
+	this->iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	this->running = true;
+	this->thread = std::thread([this]() {
+		this->loop();
+	});
+}
+
+Reactor::~Reactor()
+{
+	this->running = false;
+	PostQueuedCompletionStatus(this->iocp, 0, 0, NULL);
+	if (this->thread.joinable())
+		this->thread.join();
+	CloseHandle(this->iocp);
+}
+
+bool Reactor::arm(Entry& e)
+{
+	e.pending = e.port->serial.ReadAsync(e.buffer, sizeof(e.buffer), &e.ov);
+	e.failed = !e.pending;
+	return e.pending;
+}
+
+bool Reactor::Add(SharedPort* port)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (!port->serial.AttachCompletionPort(this->iocp, (uintptr_t)port))
+		return false;
+
+	std::unique_ptr<Entry> e(new Entry());
+	e->port = port;
+	if (!this->arm(*e))
+		return false;
+	this->entries.push_back(std::move(e));
+	return true;
+}
+
+void Reactor::Remove(SharedPort* port)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (auto it = this->entries.begin(); it != this->entries.end(); ++it) {
+		Entry& e = **it;
+		if (e.port != port || e.removed)
+			continue;
+		if (e.pending) {
+			// freed when the aborted read comes back
+			e.removed = true;
+			port->serial.CancelAsync(&e.ov);
+		}
+		else {
+			this->entries.erase(it);
+		}
+		return;
+	}
+}
+
+void Reactor::loop()
+{
+	Trace::NameThread("reactor");
+	while (this->running)
+	{
+		DWORD bytes = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* ov = NULL;
+		int64_t start = nowNs();
+		BOOL ok = GetQueuedCompletionStatus(this->iocp, &bytes, &key, &ov, PROBE_MS);
+		if (!ok && !ov && GetLastError() == WAIT_TIMEOUT)
+			this->latency.add(nowNs() - start - PROBE_MS * 1000000LL);
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		if (ov) {
+			auto it = std::find_if(this->entries.begin(), this->entries.end(),
+				[ov](const std::unique_ptr<Entry>& e) { return &e->ov == ov; });
+			if (it != this->entries.end()) {
+				Entry& e = **it;
+				e.pending = false;
+				if (e.removed) {
+					this->entries.erase(it);
+				}
+				else if (!ok) {
+					e.failed = true;
+					e.port->service(nullptr, -1);
+				}
+				else {
+					// sweep up whatever arrived between the completion and now
+					int n = (int)bytes;
+					TRACE_MARK(Trace::Read, (double)n);
+					int more = e.port->serial.ReadNow(e.buffer + n, sizeof(e.buffer) - n, n);
+					if (more > 0)
+						n += more;
+					e.port->service(e.buffer, n);
+					// a read that cannot be queued again, the device is likely
+					// gone: have the monitor reconnect like the POSIX path does
+					if (!this->arm(e))
+						e.port->service(nullptr, -1);
+				}
+			}
+		}
+
+		this->tick(nowNs());
+	}
+}
+
+#else
+
+Reactor::Reactor()
+{
+	this->epfd = epoll_create1(EPOLL_CLOEXEC);
+	this->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.ptr = nullptr;
+	epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->wakefd, &ev);
+
+	this->running = true;
+	this->thread = std::thread([this]() {
+		this->loop();
+	});
+}
+
+Reactor::~Reactor()
+{
+	this->running = false;
+	uint64_t one = 1;
+	if (write(this->wakefd, &one, sizeof(one)) < 0) {
+	}
+	if (this->thread.joinable())
+		this->thread.join();
+	::close(this->wakefd);
+	::close(this->epfd);
+}
+
+bool Reactor::Add(SharedPort* port)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	std::unique_ptr<Entry> e(new Entry());
+	e->port = port;
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.ptr = e.get();
+	if (epoll_ctl(this->epfd, EPOLL_CTL_ADD, port->serial.Fd(), &ev) != 0)
+		return false;
+
+	this->entries.push_back(std::move(e));
+	return true;
+}
+
+void Reactor::Remove(SharedPort* port)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (auto it = this->entries.begin(); it != this->entries.end(); ++it) {
+		if ((*it)->port != port)
+			continue;
+		if (!(*it)->failed)
+			epoll_ctl(this->epfd, EPOLL_CTL_DEL, port->serial.Fd(), nullptr);
+		this->entries.erase(it);
+		return;
+	}
+}
+
+void Reactor::loop()
+{
+	// one buffer is enough, ports are serviced one after the other
+	uint8_t buffer[1024];
+	Trace::NameThread("reactor");
+	epoll_event events[64];
+
+	while (this->running)
+	{
+		int64_t start = nowNs();
+		int k = epoll_wait(this->epfd, events, 64, PROBE_MS);
+		if (k < 0 && errno != EINTR)
+			break;
+		if (k == 0)
+			this->latency.add(nowNs() - start - PROBE_MS * 1000000LL);
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		for (int i = 0; i < k; i++) {
+			Entry* e = (Entry*)events[i].data.ptr;
+			if (!e) {
+				uint64_t v;
+				if (read(this->wakefd, &v, sizeof(v)) < 0) {
+				}
+				continue;
+			}
+
+			// removed by an earlier event of this batch
+			if (std::none_of(this->entries.begin(), this->entries.end(),
+				[e](const std::unique_ptr<Entry>& p) { return p.get() == e; }))
+				continue;
+
+			int n = e->port->serial.ReadNow(buffer, sizeof(buffer));
+			e->port->service(buffer, n);
+
+			// a dead fd stays readable, stop polling it and have the monitor
+			// reconnect; a hangup with nothing left to read is a read error too
+			if (n < 0 || (n == 0 && (events[i].events & (EPOLLERR | EPOLLHUP)))) {
+				if (n == 0)
+					e->port->service(nullptr, -1);
+				epoll_ctl(this->epfd, EPOLL_CTL_DEL, e->port->serial.Fd(), nullptr);
+				e->failed = true;
+			}
+		}
+
+		this->tick(nowNs());
+	}
+}
+
+#endif
+
+void Reactor::tick(int64_t now)
+{
+	if (now - this->lastTick < TICK_MS * 1000000LL)
+		return;
+	this->lastTick = now;
+
+	for (auto& e : this->entries) {
+#ifdef _WIN32
+		if (e->removed)
+			continue;
+#endif
+		e->port->service(nullptr, 0);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WakeLatency.hpp"
+
+class SharedPort;
+
+// One I/O thread for every port opened in reactor mode, instead of a
+// thread per port. Waits with epoll on POSIX and an I/O completion port
+// on Windows; each port keeps its own parser and is serviced as soon as
+// its bytes are readable.
+class Reactor {
+public:
+	static Reactor& Instance();
+
+	Reactor(const Reactor&) = delete;
+	~Reactor();
+
+	bool Add(SharedPort* port);
+	// no callback reaches the port once this returns
+	void Remove(SharedPort* port);
+
+	// how late the reactor thread wakes from its timed waits, for every
+	// port in reactor mode; reset only from a port callback
+	WakeLatency& Latency() { return this->latency; }
+
+private:
+	struct Entry;
+
+	Reactor();
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	// held while dispatching, so Add/Remove never race a callback
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Entry>> entries;
+
+#ifdef _WIN32
+	void* iocp = nullptr;
+	bool arm(Entry& e);
+#else
+	int epfd = -1;
+	int wakefd = -1;
+#endif
+
+	int64_t lastTick = 0;
+	WakeLatency latency;
+
+	void loop();
+	void tick(int64_t now);
+};
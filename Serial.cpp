@@ -1,4 +1,14 @@
 #include "Serial.hpp"
+#include "Trace.hpp"
+
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+// Read waits at most this long at a time
+#define PROBE_MS 10UL
+
+#ifdef _WIN32
 
 #include <Windows.h>
 #include <SetupAPI.h>
@@ -16,13 +26,29 @@ Serial::Serial() {
 	serialConfig = Serial::SerialConfig{ CBR_38400, 8, ODDPARITY, ONESTOPBIT };
 	opened = false;
 	handle = nullptr;
+	readEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	writeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	cancelEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	interByteTimeout = 0;
+	waitTimeout = 100;
+	wakeups = 0;
+	latencyRequest = 0;
+	latencyTimer = -1;
+	backlogSum = 0;
+	backlogMax = 0;
 }
 
 Serial::~Serial(){
 	Close();
+	CloseHandle(readEvent);
+	CloseHandle(writeEvent);
+	CloseHandle(cancelEvent);
 }
 
 bool Serial::Open(const std::string port, const SerialConfig& config) {
+	ResetInterrupt();
+
+	this->port = port;
 	Tstring path = PATH + port;
 	handle = CreateFile(
 		path.c_str(),
@@ -30,7 +56,7 @@ bool Serial::Open(const std::string port, const SerialConfig& config) {
 		0,
 		NULL,
 		OPEN_EXISTING,
-		FILE_ATTRIBUTE_NORMAL,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
 		NULL);
 	if (handle == INVALID_HANDLE_VALUE) {
 		opened = false;
@@ -39,8 +65,13 @@ bool Serial::Open(const std::string port, const SerialConfig& config) {
 
 	setConfig(config);
 	setBufferSize(1024, 1024);
+	setTimeouts();
+	SetCommMask(handle, EV_RXCHAR);
 
 	opened = true;
+	// only once the device is there, a reconnect attempt on a missing one
+	// should not pay for an enumeration
+	applyLatencyTimer();
 	return true;
 }
 
@@ -51,11 +82,9 @@ void Serial::Close(){
 	opened = false;
 }
 
-bool Serial::IsOpened() {
-	return opened;
-}
-
 void Serial::setConfig(const SerialConfig& config){
+	serialConfig = config;
+
 	DCB dcb;
 	GetCommState(handle, &dcb);
 
@@ -67,31 +96,168 @@ void Serial::setConfig(const SerialConfig& config){
 	SetCommState(handle, &dcb);
 }
 
+void Serial::setTimeouts(){
+	// ReadFile returns immediately with whatever is in the driver queue,
+	// waiting is done with WaitCommEvent
+	COMMTIMEOUTS timeouts = { 0 };
+	timeouts.ReadIntervalTimeout = MAXDWORD;
+	SetCommTimeouts(handle, &timeouts);
+}
+
+// Overlapped calls made here wait on their own event. With the low bit set
+// they are not queued to a completion port the handle may be attached to.
+static HANDLE untracked(void* event) {
+	return (HANDLE)((uintptr_t)event | 1);
+}
+
 int available(void* handle) {
 	unsigned long error;
 	COMSTAT stat;
-	ClearCommError(handle, &error, &stat);
+	if (!ClearCommError(handle, &error, &stat))
+		return -1;
 	return stat.cbInQue;
 }
 
-std::vector<unsigned char> Serial::Read(){
-	std::vector<unsigned char> vals;
+// 1: data available, 0: timeout, -1: error
+int Serial::waitReceive(unsigned long timeout){
+	if (WaitForSingleObject(cancelEvent, 0) == WAIT_OBJECT_0)
+		return 0;
+
+	int n = available(handle);
+	if (n != 0)
+		return n > 0 ? 1 : -1;
 
-	unsigned long readSize;
-	int read_size = available(handle);
-	if (read_size == 0) {
-		read_size = 1;
+	OVERLAPPED ov = { 0 };
+	ov.hEvent = untracked(readEvent);
+	ResetEvent(readEvent);
+
+	unsigned long mask = 0;
+	if (!WaitCommEvent(handle, &mask, &ov)) {
+		if (GetLastError() != ERROR_IO_PENDING)
+			return -1;
+		HANDLE events[2] = { readEvent, cancelEvent };
+		int64_t start = WakeLatency::now();
+		DWORD w = WaitForMultipleObjects(2, events, FALSE, timeout);
+		if (w == WAIT_TIMEOUT)
+			wakeLatency.add(WakeLatency::now() - start - (int64_t)timeout * 1000000);
+		if (w != WAIT_OBJECT_0) {
+			CancelIo(handle);
+			unsigned long dummy;
+			GetOverlappedResult(handle, &ov, &dummy, TRUE);
+			return 0;
+		}
+		unsigned long dummy;
+		if (!GetOverlappedResult(handle, &ov, &dummy, FALSE))
+			return -1;
 	}
-	unsigned char* data = new unsigned char[read_size];
-	bool status = ReadFile(handle, data, read_size, &readSize, NULL);
-	if (!status)
-		return vals;
+	return (mask & EV_RXCHAR) ? 1 : 0;
+}
+
+int Serial::readAvailable(uint8_t* dst, size_t cap){
+	int n = available(handle);
+	if (n <= 0)
+		return n;
+	if ((size_t)n > cap)
+		n = (int)cap;
+
+	OVERLAPPED ov = { 0 };
+	ov.hEvent = untracked(readEvent);
+	ResetEvent(readEvent);
 
-	for (int i = 0; i < read_size; i++) {
-		vals.push_back(data[i]);
+	unsigned long readSize = 0;
+	if (!ReadFile(handle, dst, n, &readSize, &ov)) {
+		if (GetLastError() != ERROR_IO_PENDING)
+			return -1;
+		if (!GetOverlappedResult(handle, &ov, &readSize, TRUE))
+			return -1;
 	}
-	delete[] data;
-	return vals;
+	return (int)readSize;
+}
+
+bool Serial::AttachCompletionPort(void* iocp, uintptr_t key){
+	if (CreateIoCompletionPort(handle, iocp, key, 0) == NULL)
+		return false;
+
+	// a read returns as soon as at least one byte is queued,
+	// or with nothing after the wait timeout
+	COMMTIMEOUTS timeouts = { 0 };
+	timeouts.ReadIntervalTimeout = MAXDWORD;
+	timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+	timeouts.ReadTotalTimeoutConstant = waitTimeout;
+	return SetCommTimeouts(handle, &timeouts) != FALSE;
+}
+
+bool Serial::ReadAsync(uint8_t* dst, size_t cap, void* overlapped){
+	OVERLAPPED* ov = (OVERLAPPED*)overlapped;
+	memset(ov, 0, sizeof(OVERLAPPED));
+
+	// completes through the port either way
+	if (ReadFile(handle, dst, (DWORD)cap, NULL, ov))
+		return true;
+	return GetLastError() == ERROR_IO_PENDING;
+}
+
+void Serial::CancelAsync(void* overlapped){
+	CancelIoEx(handle, (OVERLAPPED*)overlapped);
+}
+
+void Serial::Interrupt(){
+	SetEvent(cancelEvent);
+}
+
+void Serial::ResetInterrupt(){
+	ResetEvent(cancelEvent);
+}
+
+bool Serial::WaitInterrupt(unsigned long ms){
+	return WaitForSingleObject(cancelEvent, ms) == WAIT_OBJECT_0;
+}
+
+// FTDI's VCP driver keeps LatencyTimer next to PortName in the device key.
+// Finding that key means a SetupAPI enumeration, so it is only looked up
+// when a value was asked for.
+void Serial::applyLatencyTimer(){
+	latencyTimer = -1;
+	if (latencyRequest <= 0)
+		return;
+
+	GUID guid;
+	unsigned long guid_size = 0;
+	if (SetupDiClassGuidsFromName(PORTS, &guid, 1, &guid_size) == FALSE)
+		return;
+	HDEVINFO hinfo = SetupDiGetClassDevs(&guid, 0, 0, DIGCF_PRESENT | DIGCF_PROFILE);
+	if (hinfo == INVALID_HANDLE_VALUE)
+		return;
+
+	SP_DEVINFO_DATA info_data = { 0 };
+	info_data.cbSize = sizeof(SP_DEVINFO_DATA);
+	for (unsigned int index = 0; SetupDiEnumDeviceInfo(hinfo, index, &info_data); index++) {
+		HKEY hkey = SetupDiOpenDevRegKey(hinfo, &info_data, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ | KEY_SET_VALUE);
+		if (hkey == INVALID_HANDLE_VALUE)
+			hkey = SetupDiOpenDevRegKey(hinfo, &info_data, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+		if (hkey == INVALID_HANDLE_VALUE)
+			continue;
+
+		Tchar name[MAX_PATH] = { 0 };
+		unsigned long type;
+		unsigned long size = sizeof(name) - 1;
+		bool match = RegQueryValueEx(hkey, PORTNAME, 0, &type, (LPBYTE)name, &size) == ERROR_SUCCESS && port == name;
+
+		DWORD value = 0;
+		size = sizeof(value);
+		if (match && RegQueryValueEx(hkey, "LatencyTimer", 0, &type, (LPBYTE)&value, &size) == ERROR_SUCCESS && type == REG_DWORD) {
+			// needs write access to the key, usually administrator rights
+			DWORD wanted = (DWORD)latencyRequest;
+			if (value != wanted &&
+				RegSetValueEx(hkey, "LatencyTimer", 0, REG_DWORD, (const BYTE*)&wanted, sizeof(wanted)) == ERROR_SUCCESS)
+				value = wanted;
+			latencyTimer = (int)value;
+		}
+		RegCloseKey(hkey);
+		if (match)
+			break;
+	}
+	SetupDiDestroyDeviceInfoList(hinfo);
 }
 
 void Serial::Clear(){
@@ -106,15 +272,18 @@ void Serial::ClearRead(){
 	PurgeComm(handle, PURGE_RXABORT | PURGE_RXCLEAR);
 }
 
-int Serial::Write(const std::vector<unsigned char>& data){
-	unsigned long writtenSize;
-	int size = data.size();
-	char* buff = new char[size];
-	for (int i = 0; i < size; i++) {
-		buff[i] = data[i];
-	}
+int Serial::Write(const uint8_t* src, size_t size){
+	OVERLAPPED ov = { 0 };
+	ov.hEvent = untracked(writeEvent);
+	ResetEvent(writeEvent);
 
-	WriteFile(handle, buff, size, &writtenSize, NULL);
+	unsigned long writtenSize = 0;
+	if (!WriteFile(handle, src, (DWORD)size, &writtenSize, &ov)) {
+		if (GetLastError() != ERROR_IO_PENDING)
+			return -1;
+		if (!GetOverlappedResult(handle, &ov, &writtenSize, TRUE))
+			return -1;
+	}
 	return writtenSize;
 }
 
@@ -160,3 +329,119 @@ std::vector<std::string> getSerialList() {
 	return list;
 
 }
+
+#endif
+
+bool Serial::IsOpened() {
+	return opened;
+}
+
+int Serial::Read(uint8_t* dst, size_t cap){
+	// in slices, so the reader wakes on a deadline now and then even while
+	// data flows and its wake latency is sampled
+	int w;
+	unsigned long left = waitTimeout;
+	do {
+		unsigned long slice = left < PROBE_MS ? left : PROBE_MS;
+		w = waitReceive(slice);
+		left -= slice;
+	} while (w == 0 && left > 0 && !WaitInterrupt(0));
+	if (w <= 0)
+		return w;
+
+	size_t total = 0;
+	while (total < cap) {
+		int n = readAvailable(dst + total, cap - total);
+		if (n < 0)
+			return total ? (int)total : -1;
+		if (n == 0)
+			break;
+		if (total == 0)
+			countWake(n);
+		total += n;
+		if (interByteTimeout == 0 || total == cap)
+			break;
+		// sleep through the bytes that follow rather than wake for each of
+		// them; the line is quiet once a whole timeout brought nothing
+		if (WaitInterrupt(interByteTimeout))
+			break;
+	}
+	TRACE_MARK(Trace::Read, (double)total);
+	return (int)total;
+}
+
+std::vector<unsigned char> Serial::Read(){
+	std::vector<unsigned char> vals;
+
+	uint8_t data[1024];
+	int n = Read(data, sizeof(data));
+	if (n < 0) {
+		// don't let a dead handle spin the caller
+		WaitInterrupt(waitTimeout);
+		return vals;
+	}
+	vals.assign(data, data + n);
+	return vals;
+}
+
+void Serial::SetInterByteTimeout(unsigned long ms){
+	interByteTimeout = ms;
+}
+
+void Serial::SetWaitTimeout(unsigned long ms){
+	waitTimeout = ms;
+}
+
+void Serial::SetLatencyTimer(int ms){
+	latencyRequest = ms;
+	if (opened)
+		applyLatencyTimer();
+}
+
+int Serial::LatencyTimer(){
+	return latencyTimer;
+}
+
+unsigned long long Serial::Wakeups(){
+	return wakeups;
+}
+
+int Serial::ReadNow(uint8_t* dst, size_t cap, size_t pending){
+	int n = readAvailable(dst, cap);
+	if (n < 0)
+		return n;
+	countWake(pending + n);
+	if (n > 0)
+		TRACE_MARK(Trace::Read, (double)n);
+	return n;
+}
+
+void Serial::countWake(size_t backlog){
+	if (backlog == 0)
+		return;
+	wakeups++;
+
+	backlogSum += backlog;
+	unsigned long long max = backlogMax;
+	while (backlog > max && !backlogMax.compare_exchange_weak(max, backlog)) {
+	}
+}
+
+double Serial::BacklogAvg(){
+	unsigned long long n = wakeups;
+	return n ? backlogSum / (double)n : 0.0;
+}
+
+double Serial::BacklogMax(){
+	return (double)backlogMax;
+}
+
+unsigned long long Serial::byteNs(){
+	// start + data + parity + stop bits
+	unsigned int bits = 1 + serialConfig.ByteSize + (serialConfig.Parity != NOPARITY ? 1 : 0) + (serialConfig.StopBits == ONESTOPBIT ? 1 : 2);
+	return 1000000000ULL * bits / (serialConfig.BaudRate ? serialConfig.BaudRate : CBR_38400);
+}
+
+int Serial::Write(const std::vector<unsigned char>& data){
+	return Write(data.data(), data.size());
+}
@@ -1,11 +1,33 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "WakeLatency.hpp"
+
 using Tstring = std::string;
 using Tchar = char;
 
+#ifndef _WIN32
+// same values as the Win32 DCB constants so SerialConfig is portable
+#define CBR_9600 9600
+#define CBR_19200 19200
+#define CBR_38400 38400
+#define CBR_57600 57600
+#define CBR_115200 115200
+#define NOPARITY 0
+#define ODDPARITY 1
+#define EVENPARITY 2
+#define MARKPARITY 3
+#define SPACEPARITY 4
+#define ONESTOPBIT 0
+#define ONE5STOPBITS 1
+#define TWOSTOPBITS 2
+#endif
+
 std::vector<std::string> getSerialList();
 
 class Serial {
@@ -23,9 +45,37 @@ private:
 	std::string port;
 
 	bool opened;
+#ifdef _WIN32
 	void* handle;
+	void* readEvent;
+	void* writeEvent;
+	void* cancelEvent;
+#else
+	int fd;
+	int cancelPipe[2];
+#endif
+
+	unsigned long interByteTimeout;
+	unsigned long waitTimeout;
+	std::atomic<unsigned long long> wakeups;
+	int latencyRequest;
+	std::atomic<int> latencyTimer;
+#ifndef _WIN32
+	std::string sysfsRoot;
+#endif
+	std::atomic<unsigned long long> backlogSum;
+	std::atomic<unsigned long long> backlogMax;
+	WakeLatency wakeLatency;
+
 	void setConfig(const SerialConfig&);
 	void setBufferSize(unsigned long read, unsigned long write);
+	void setTimeouts();
+
+	int waitReceive(unsigned long timeout);
+	int readAvailable(uint8_t* dst, size_t cap);
+	void countWake(size_t backlog);
+	unsigned long long byteNs();
+	void applyLatencyTimer();
 
 public:
 	Serial();
@@ -36,8 +86,67 @@ public:
 	void Close();
 	bool IsOpened();
 
+	// Waits up to the wait timeout for the first byte, then sleeps for the
+	// inter-byte timeout and collects what arrived meanwhile, until a sleep
+	// brings nothing (0 = return as soon as the first burst has been read).
+	// Gaps shorter than the timeout are bridged at one wakeup per timeout
+	// instead of one per byte.
+	// Returns the number of bytes stored in dst, 0 on timeout, -1 on error.
+	int Read(uint8_t* dst, size_t cap);
 	std::vector<unsigned char> Read();
+	// Makes a Read blocked in another thread return 0 right away, and every
+	// later wait too until ResetInterrupt() or the next Open().
+	void Interrupt();
+	void ResetInterrupt();
+	// sleeps up to ms, returns early (true) when interrupted
+	bool WaitInterrupt(unsigned long ms);
+	void SetInterByteTimeout(unsigned long ms);
+	void SetWaitTimeout(unsigned long ms);
+
+	// USB adapters such as FTDI hold received bytes until their latency
+	// timer runs out (16 ms by default). ms > 0 lowers it when the port
+	// is opened, and at once if it is open already; 0 leaves the driver
+	// setting alone. Windows keeps it in the driver's registry key, which
+	// the driver may only read when the device starts.
+	void SetLatencyTimer(int ms);
+	// effective value in ms, -1 when the port has no such timer; on Windows
+	// also while none was asked for, as reading it costs an enumeration
+	int LatencyTimer();
+#ifndef _WIN32
+	// where sysfs is mounted, for testing against a fake tree
+	void SetSysfsRoot(const std::string& root);
+#endif
+	// time one byte takes on the line at the current settings
+	unsigned long long ByteNs() { return byteNs(); }
+	unsigned long long Wakeups();
+
+	// Bytes already queued when a wakeup read them. With USB adapters this
+	// is mostly set by the latency timer, a whole frame per transfer.
+	double BacklogAvg();	// bytes
+	double BacklogMax();	// bytes
+
+	// How late the thread calling Read wakes from its timed waits. Read
+	// waits in slices of at most 10 ms so there are samples while data
+	// flows too. Reset it from that thread only.
+	WakeLatency& Latency() { return wakeLatency; }
+
+	// For an external reactor: reads whatever is queued without waiting and
+	// counts one wakeup. pending is what the reactor already read for this
+	// wakeup, so the backlog covers both.
+	int ReadNow(uint8_t* dst, size_t cap, size_t pending = 0);
+#ifdef _WIN32
+	// associates the handle with an I/O completion port, reads are then
+	// issued with ReadAsync and complete as soon as one byte has arrived
+	bool AttachCompletionPort(void* iocp, uintptr_t key);
+	bool ReadAsync(uint8_t* dst, size_t cap, void* overlapped);
+	void CancelAsync(void* overlapped);
+#else
+	int Fd();
+#endif
 
+	// Returns the bytes written, fewer when the line stays busy past the
+	// timeout, -1 on error.
+	int Write(const uint8_t* src, size_t size);
 	int Write(const std::vector<unsigned char>& data);
 
 	void Clear();
@@ -0,0 +1,329 @@
+#include "Serial.hpp"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+#define PATH "/dev/"
+#define BY_ID "/dev/serial/by-id/"
+
+void Serial::setBufferSize(unsigned long, unsigned long){
+	// the tty layer sizes its own buffers
+}
+
+Serial::Serial() {
+	serialConfig = Serial::SerialConfig{ CBR_38400, 8, ODDPARITY, ONESTOPBIT };
+	opened = false;
+	fd = -1;
+	if (pipe(cancelPipe) == 0) {
+		for (int p : cancelPipe) {
+			fcntl(p, F_SETFL, O_NONBLOCK);
+			fcntl(p, F_SETFD, FD_CLOEXEC);
+		}
+	}
+	else {
+		cancelPipe[0] = cancelPipe[1] = -1;
+	}
+	interByteTimeout = 0;
+	waitTimeout = 100;
+	wakeups = 0;
+	latencyRequest = 0;
+	latencyTimer = -1;
+	sysfsRoot = "/sys";
+	backlogSum = 0;
+	backlogMax = 0;
+}
+
+Serial::~Serial(){
+	Close();
+	if (cancelPipe[0] >= 0) {
+		::close(cancelPipe[0]);
+		::close(cancelPipe[1]);
+	}
+}
+
+bool Serial::Open(const std::string port, const SerialConfig& config) {
+	ResetInterrupt();
+
+	Tstring path = port.size() && port[0] == '/' ? port : PATH + port;
+	fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		opened = false;
+		return false;
+	}
+
+	// same as share mode 0 on Windows
+	if (isatty(fd) == 0 || ioctl(fd, TIOCEXCL) != 0 || flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		::close(fd);
+		fd = -1;
+		opened = false;
+		return false;
+	}
+
+	this->port = path;
+	opened = true;
+	setConfig(config);
+	setBufferSize(1024, 1024);
+	setTimeouts();
+	applyLatencyTimer();
+	return true;
+}
+
+void Serial::Close(){
+	if (opened) {
+		::close(fd);
+		fd = -1;
+	}
+	opened = false;
+}
+
+static speed_t toSpeed(unsigned int baud) {
+	switch (baud) {
+	case 1200: return B1200;
+	case 2400: return B2400;
+	case 4800: return B4800;
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	default: return B38400;
+	}
+}
+
+void Serial::setConfig(const SerialConfig& config){
+	serialConfig = config;
+
+	termios tio;
+	if (tcgetattr(fd, &tio) != 0)
+		return;
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+
+	tio.c_cflag &= ~CSIZE;
+	switch (config.ByteSize) {
+	case 5: tio.c_cflag |= CS5; break;
+	case 6: tio.c_cflag |= CS6; break;
+	case 7: tio.c_cflag |= CS7; break;
+	default: tio.c_cflag |= CS8; break;
+	}
+
+	tio.c_cflag &= ~(PARENB | PARODD);
+#ifdef CMSPAR
+	tio.c_cflag &= ~CMSPAR;
+#endif
+	switch (config.Parity) {
+	case ODDPARITY: tio.c_cflag |= PARENB | PARODD; break;
+	case EVENPARITY: tio.c_cflag |= PARENB; break;
+#ifdef CMSPAR
+	case MARKPARITY: tio.c_cflag |= PARENB | PARODD | CMSPAR; break;
+	case SPACEPARITY: tio.c_cflag |= PARENB | CMSPAR; break;
+#endif
+	default: break;
+	}
+
+	if (config.StopBits == TWOSTOPBITS || config.StopBits == ONE5STOPBITS)
+		tio.c_cflag |= CSTOPB;
+	else
+		tio.c_cflag &= ~CSTOPB;
+
+	cfsetispeed(&tio, toSpeed(config.BaudRate));
+	cfsetospeed(&tio, toSpeed(config.BaudRate));
+	tcsetattr(fd, TCSANOW, &tio);
+}
+
+void Serial::setTimeouts(){
+	// read() returns immediately with whatever is in the tty queue,
+	// waiting is done with poll
+	termios tio;
+	if (tcgetattr(fd, &tio) != 0)
+		return;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	tcsetattr(fd, TCSANOW, &tio);
+}
+
+static int available(int fd) {
+	int n = 0;
+	if (ioctl(fd, FIONREAD, &n) != 0)
+		return -1;
+	return n;
+}
+
+// 1: data available, 0: timeout or interrupted, -1: error
+int Serial::waitReceive(unsigned long timeout){
+	pollfd p[2] = { { fd, POLLIN, 0 }, { cancelPipe[0], POLLIN, 0 } };
+	int64_t start = WakeLatency::now();
+	int r = poll(p, 2, (int)timeout);
+	if (r < 0)
+		return errno == EINTR ? 0 : -1;
+	if (r == 0) {
+		wakeLatency.add(WakeLatency::now() - start - (int64_t)timeout * 1000000);
+		return 0;
+	}
+	if (p[1].revents)
+		return 0;
+	if (p[0].revents & POLLIN)
+		return 1;
+	return -1;
+}
+
+// the pipe stays readable until reset, so an interrupt that lands before
+// the wait is not lost
+void Serial::Interrupt(){
+	char c = 1;
+	if (::write(cancelPipe[1], &c, 1) < 0) {
+		// full, already interrupted
+	}
+}
+
+void Serial::ResetInterrupt(){
+	char buf[64];
+	while (::read(cancelPipe[0], buf, sizeof(buf)) > 0) {
+	}
+}
+
+bool Serial::WaitInterrupt(unsigned long ms){
+	pollfd p = { cancelPipe[0], POLLIN, 0 };
+	return poll(&p, 1, (int)ms) > 0;
+}
+
+int Serial::readAvailable(uint8_t* dst, size_t cap){
+	int n = available(fd);
+	if (n <= 0)
+		return n;
+	ssize_t r = ::read(fd, dst, std::min((size_t)n, cap));
+	if (r < 0)
+		return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+	return (int)r;
+}
+
+int Serial::Fd(){
+	return fd;
+}
+
+// /dev/serial/by-id/... and other links resolve to the ttyUSBn the driver knows
+static std::string ttyName(const std::string& path) {
+	char buf[PATH_MAX];
+	std::string real = realpath(path.c_str(), buf) ? buf : path;
+	size_t slash = real.rfind('/');
+	return slash == std::string::npos ? real : real.substr(slash + 1);
+}
+
+// ftdi_sio and a few other usb-serial drivers expose latency_timer in sysfs
+void Serial::applyLatencyTimer(){
+	std::string file = sysfsRoot + "/bus/usb-serial/devices/" + ttyName(port) + "/latency_timer";
+
+	if (latencyRequest > 0) {
+		// usually needs root or a udev rule
+		if (FILE* f = fopen(file.c_str(), "w")) {
+			fprintf(f, "%d", latencyRequest);
+			fclose(f);
+		}
+#ifdef __linux__
+		// the tty layer's low latency flag, fails quietly on ports without it
+		serial_struct ss;
+		if (ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+			ss.flags |= ASYNC_LOW_LATENCY;
+			ioctl(fd, TIOCSSERIAL, &ss);
+		}
+#endif
+	}
+
+	int value = -1;
+	if (FILE* f = fopen(file.c_str(), "r")) {
+		if (fscanf(f, "%d", &value) != 1)
+			value = -1;
+		fclose(f);
+	}
+	latencyTimer = value;
+}
+
+void Serial::SetSysfsRoot(const std::string& root){
+	sysfsRoot = root;
+}
+
+void Serial::Clear(){
+	tcflush(fd, TCIOFLUSH);
+}
+
+void Serial::ClearWrite(){
+	tcflush(fd, TCOFLUSH);
+}
+
+void Serial::ClearRead(){
+	tcflush(fd, TCIFLUSH);
+}
+
+int Serial::Write(const uint8_t* src, size_t size){
+	size_t written = 0;
+	while (written < size) {
+		ssize_t r = ::write(fd, src + written, size - written);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				// give up when the line stays full for the wait timeout or goes away
+				pollfd p = { fd, POLLOUT, 0 };
+				int w = poll(&p, 1, (int)waitTimeout);
+				if (w < 0 && errno == EINTR)
+					continue;
+				if (w == 0)
+					return (int)written;
+				if (w < 0 || (p.revents & (POLLERR | POLLHUP | POLLNVAL)))
+					return written ? (int)written : -1;
+				continue;
+			}
+			return written ? (int)written : -1;
+		}
+		written += r;
+	}
+	return (int)written;
+}
+
+static void listDir(const char* dir, const char* prefix, std::vector<std::string>& list) {
+	DIR* d = opendir(dir);
+	if (!d)
+		return;
+	std::vector<std::string> names;
+	while (dirent* e = readdir(d)) {
+		std::string name = e->d_name;
+		if (name == "." || name == "..")
+			continue;
+		if (prefix && name.compare(0, strlen(prefix), prefix) != 0)
+			continue;
+		names.push_back(dir + name);
+	}
+	closedir(d);
+	std::sort(names.begin(), names.end());
+	list.insert(list.end(), names.begin(), names.end());
+}
+
+std::vector<std::string> getSerialList() {
+	std::vector<std::string> list;
+	listDir(PATH, "ttyS", list);
+	listDir(PATH, "ttyUSB", list);
+	listDir(PATH, "ttyACM", list);
+	listDir(BY_ID, nullptr, list);
+	return list;
+}
+
+#endif
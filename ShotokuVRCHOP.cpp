@@ -23,8 +23,15 @@
 #include <chrono>
 #include <algorithm>
 #include <numeric>
+#include <array>
+#include <atomic>
 
-#include "Serial.hpp"
+#include "PortRegistry.hpp"
+#include "Logger.hpp"
+#include "D1Batch.hpp"
+#include "PoseHistory.hpp"
+#include "Predictor.hpp"
+#include "Trace.hpp"
 
 using namespace std;
 
@@ -32,237 +39,326 @@ class ShotokuVRCHOP : public CHOP_CPlusPlusBase
 {
 public:
 	std::string portname = "";
-	int cameraid = 0;
-
-	std::vector<std::string> chanNames{ "tx", "ty", "tz", "rx", "ry", "rz", "zoom", "focus", "fps", "fpsavg" };
-	std::vector<double> chanValues{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	bool reactor = false;
+
+	// channels per camera, the optional groups follow the pose
+	std::vector<std::string> poseNames{ "tx", "ty", "tz", "rx", "ry", "rz", "zoom", "focus", "fps", "fpsavg" };
+	std::vector<std::string> chanNames{ poseNames };
+	// first channel of each optional group, -1 when it is off
+	int rateOffset = -1;
+	int predictOffset = -1;
+	int velocityOffset = -1;
+	int accelerationOffset = -1;
+	int shutterOffset = -1;
+	int parDerivatives = -1;
+	std::vector<double> values;
+
+	// what a camera outputs once its last frame is older than the threshold
+	enum Stale { Hold, Zero, Extrapolate };
+	int stalePolicy = Hold;
+	int64_t staleNs = 0;
+	int64_t extrapolateNs = 0;
+
+	// cook side pose history of the output cameras, allocated on first use
+	std::array<std::unique_ptr<PoseHistory>, 256> histories;
+	std::array<std::unique_ptr<Predictor>, 256> predictors;
+	int parHistory = -1;
+
+	// extrapolates fresh poses to now + lead
+	int predictModel = Predictor::Off;
+	int64_t leadNs = 0;
+	double kalmanNoise = 1.0;
+	// set but off, timeslice samples keep their own times
+	bool predictIgnored = false;
+
+	// outputs the pose of now - delay from the history instead, wins over the prediction
+	int64_t delayNs = 0;
+	bool delayHermite = true;
+
+	// exposure ending at the (delayed) output time: its mean replaces the
+	// pose, or its first and last pose go to open_* and close_*
+	enum Shutter { ShutterOff, ShutterMean, ShutterOpenClose };
+	int shutterMode = ShutterOff;
+	int64_t shutterNs = 0;
+
+	// camera ids in output order, one in single camera mode
+	std::vector<int> outputIds{ 0 };
 
 	std::vector<double> transform{ 0.0, 0.0, 0.0 };
 	std::vector<double> rotate{ 0.0, 0.0, 0.0 };
 
-	double zoom_max = 0.0;
-	double zoom_min = 0.0;
-	double focus_max = 0.0;
-	double focus_min = 0.0;
-
-	int last_sec = 0;
-	int fps_counter = 0;
-	time_t now = NULL;
-
-	std::vector<double> fpsHistory{};
-
-	std::thread recv_thread;
-	bool running;
-
-	Serial serial;
+	// receiver state for this node, filled by the shared port thread
+	Mailbox mailbox;
+	std::shared_ptr<SharedPort> port;
+
+	std::vector<Sample> slice;
+	std::vector<double> sliceColumns;
+
+	int parCameraid = -1;
+	int parTimeslice = -1;
+	int parInterbyte = -1;
+	int parMulticamera = -1;
+	int parSilence = -1;
+
+	std::string warning;
+	uint64_t lastChecksumErrors = 0;
+	uint64_t lastPackets = 0;
+	uint64_t lastMismatches = 0;
+	int64_t checksumTime = INT64_MIN / 2;
+	int64_t packetTime = INT64_MIN / 2;
+	int64_t mismatchTime = INT64_MIN / 2;
+	int parLatency = -1;
+	std::string parLogfile;
+	int parTrace = -1;
+	std::string traceFile;
+	ThreadTuning parTuning;
+	bool parTuningSent = false;
 
 	ShotokuVRCHOP(const OP_NodeInfo* info)
 	{
-		this->running = false;
+		this->slice.reserve(256);
+		this->sliceColumns.reserve(256 * D1::FIELDS);
 	}
 
 	virtual ~ShotokuVRCHOP()
 	{
 		this->stop();
-		this->close();
 	}
 
-	bool open()
-	{
-		// search device
-		bool found = false;
-		auto list = getSerialList();
-		for (const auto p : list) {
-			if (this->portname == p)
-				found = true;
-		}
-
-		// device not found
-		if (!found) {
-			return false;
-		}
-
-		Serial::SerialConfig serialConfig = { CBR_38400, 8, ODDPARITY, ONESTOPBIT };
+	// cook time: offsets and lens normalization for one decoded sample
+	void readRotation(const D1::Pose& data, double* values) {
+		values[3] = data.rx + this->rotate[0];
+		values[4] = data.ry + this->rotate[1];
+		values[5] = data.rz + this->rotate[2];
+	}
 
-		// open error
-		if (!this->serial.Open(this->portname, serialConfig)) {
-			return false;
-		}
+	void readTransformation(const D1::Pose& data, double* values) {
+		values[0] = data.tx + this->transform[0];
+		values[1] = data.ty + this->transform[1];
+		values[2] = data.tz + this->transform[2];
+	}
 
-		cout << "open success" << endl;
+	void readLenzData(const D1::Pose& data, const Sample& sample, double* values) {
+		values[6] = normalizeLenz(data.zoom, sample.zoom_min, sample.zoom_max);
+		values[7] = normalizeLenz(data.focus, sample.focus_min, sample.focus_max);
+	}
 
-		return true;
+	// a lens range is only set once both ends are known
+	static bool lenzRange(int32_t min, int32_t max) {
+		return max > 0 && min > 0 && max > min;
 	}
 
-	void start()
-	{
-		std::cout << "thread start" << std::endl;
+	static double normalizeLenz(int32_t v, int32_t min, int32_t max) {
+		if (lenzRange(min, max))
+			return (double)(max - v) / (double)(max - min);
+		return 0.0;
+	}
 
-		assert(this->serial);
-		recv_thread = std::thread([this]() {
-			this->loop();
-		});
+	void readSample(const Sample& sample, const D1::Pose& data, double* values) {
+		this->readTransformation(data, values);
+		this->readRotation(data, values);
+		this->readLenzData(data, sample, values);
+		values[8] = sample.fps;
+		values[9] = sample.fpsavg;
+		if (this->rateOffset >= 0) {
+			double* rate = values + this->rateOffset;
+			rate[0] = sample.interval;
+			rate[1] = sample.intervalMin;
+			rate[2] = sample.intervalMax;
+			rate[3] = sample.jitter;
+			rate[4] = sample.jitterP99;
+		}
+		if (this->velocityOffset >= 0)
+			readDerivative(sample, sample.velocity, values + this->velocityOffset);
+		if (this->accelerationOffset >= 0)
+			readDerivative(sample, sample.acceleration, values + this->accelerationOffset);
 	}
 
-	void loop()
-	{
-		this->running = true;
+	// lens rates in the normalized units of the zoom and focus channels
+	static void readDerivative(const Sample& sample, const double* d, double* values) {
+		for (int i = 0; i < 6; i++) {
+			values[i] = d[i];
+		}
+		values[6] = lenzRange(sample.zoom_min, sample.zoom_max) ? -d[6] / (sample.zoom_max - sample.zoom_min) : 0.0;
+		values[7] = lenzRange(sample.focus_min, sample.focus_max) ? -d[7] / (sample.focus_max - sample.focus_min) : 0.0;
+	}
 
-		unsigned char data[29] = { 0 };
-		int pos = 0;
+	// age_ms and valid follow fpsavg
+	static const int AGE = 10;
+	static const int VALID = 11;
 
-		while (this->running)
-		{
-			auto v = this->serial.Read();
-			for (auto c : v) {
-				c &= 0xff;
+	void updatePoseNames(const OP_Inputs* inputs)
+	{
+		this->poseNames = { "tx", "ty", "tz", "rx", "ry", "rz", "zoom", "focus", "fps", "fpsavg", "age_ms", "valid" };
 
-				if (pos <= 0 && c == 0xd1) {
-					data[0] = c;
-					unsigned char data[29] = { 0 };
-					pos = 1;
-					continue;
-				}
+		this->rateOffset = -1;
+		if (inputs->getParInt("Ratestats")) {
+			this->rateOffset = (int)this->poseNames.size();
+			this->poseNames.insert(this->poseNames.end(), { "interval_ms", "interval_min_ms", "interval_max_ms", "jitter_ms", "jitter_p99_ms" });
+		}
 
-				if (pos > 0 && pos < 29) {
-					data[pos++] = c;
-				}
+		// per s and per s^2, computed by the receiver over the last frames
+		int derivatives = inputs->getParInt("Derivatives");
+		this->velocityOffset = -1;
+		this->accelerationOffset = -1;
+		if (derivatives >= 1) {
+			this->velocityOffset = (int)this->poseNames.size();
+			this->poseNames.insert(this->poseNames.end(), { "vtx", "vty", "vtz", "vrx", "vry", "vrz", "vzoom", "vfocus" });
+		}
+		if (derivatives >= 2) {
+			this->accelerationOffset = (int)this->poseNames.size();
+			this->poseNames.insert(this->poseNames.end(), { "atx", "aty", "atz", "arx", "ary", "arz", "azoom", "afocus" });
+		}
+		int window = derivatives ? inputs->getParInt("Derivwindow") : 0;
+		if (window != this->parDerivatives && this->mailbox.commands.push({ Command::Derivatives, { (double)window } }))
+			this->parDerivatives = window;
+
+		this->shutterOffset = -1;
+		if (this->shutterMode == ShutterOpenClose) {
+			this->shutterOffset = (int)this->poseNames.size();
+			this->poseNames.insert(this->poseNames.end(), {
+				"open_tx", "open_ty", "open_tz", "open_rx", "open_ry", "open_rz", "open_zoom", "open_focus",
+				"close_tx", "close_ty", "close_tz", "close_rx", "close_ry", "close_rz", "close_zoom", "close_focus" });
+		}
 
-				if (pos == 29) {
-					if (isValidData(data)) {
-						this->handleData(data);
-						unsigned char data[29] = { 0 };
-						pos = 0;
-					}
-					else {
-						pos = -1;
-					}
-				}
-			}
+		this->predictOffset = -1;
+		if (this->predictModel != Predictor::Off) {
+			this->predictOffset = (int)this->poseNames.size();
+			this->poseNames.insert(this->poseNames.end(), { "pred_err_mm", "pred_err_deg", "pred_rms_mm", "pred_rms_deg" });
 		}
 	}
 
-	bool isValidData(unsigned char data[29])
+	void writePose(const TimedPose& p, const Sample& sample, double* values)
 	{
-		if (data[1] != this->cameraid) {
-			std::cout << "Camera id Error: is the Camera ID really " << this->cameraid << "?" << std::endl;
-			return false;
-		}
-		if (!this->checkSum(data)) {
-			std::cout << "Check Sum Error" << std::endl;
-			return false;
-		}
-		return true;
+		D1::Pose pose = p.pose();
+		this->readTransformation(pose, values);
+		this->readRotation(pose, values);
+		this->readLenzData(pose, sample, values);
 	}
 
-	bool checkSum(unsigned char data[29])
+	// replaces the pose of a fresh sample with the one predicted for now + lead,
+	// a stale one is left to the stale policy
+	void applyPrediction(int id, const Sample& sample, int64_t now, bool fresh, double* values)
 	{
-		int s = 0;
-		for (int i  = 0; i < 28; i++) {
-			s += int(data[i]);
-		}
-		return data[28] == (unsigned char)(0x40 - (s & 0xff));
+		if (!this->histories[id] || !this->predictors[id])
+			return;
+		const PoseHistory& history = *this->histories[id];
+		Predictor& predictor = *this->predictors[id];
+
+		predictor.update(history, this->kalmanNoise);
+		TimedPose p;
+		if (fresh && history.size() && history.back().time == sample.time &&
+			predictor.predict(history, this->predictModel, now + this->leadNs, p))
+			this->writePose(p, sample, values);
+
+		double* err = values + this->predictOffset;
+		err[0] = predictor.errorMm();
+		err[1] = predictor.errorDeg();
+		err[2] = predictor.rmsMm();
+		err[3] = predictor.rmsDeg();
 	}
 
-	void handleData(unsigned char data[29])
+	// the newest frame of a camera is past the threshold: hold, zero or
+	// extrapolate the pose from the last two frames until it is
+	// extrapolateNs old, then hold
+	void applyStalePolicy(int id, const Sample& sample, int64_t age, double* values)
 	{
-		this->measureFps();
-		this->readTransformation(data);
-		this->readRotation(data);
-		this->readLenzData(data);
-	}
+		if (this->stalePolicy == Zero) {
+			std::fill(values, values + 8, 0.0);
+			return;
+		}
+		if (this->stalePolicy != Extrapolate || !this->histories[id])
+			return;
 
-	void readRotation(unsigned char data[29]) {
-		auto rx = this->hexToInt(data[5], data[6], data[7]) / 32768.0 + this->rotate[0];
-		auto ry = this->hexToInt(data[2], data[3], data[4]) / 32768.0 + this->rotate[1];
-		auto rz = this->hexToInt(data[8], data[9], data[10]) / 32768.0 + this->rotate[2];
+		const PoseHistory& history = *this->histories[id];
+		size_t n = history.size();
+		if (n < 2 || history.back().time != sample.time)
+			return;
+		const TimedPose& a = history[n - 2];
+		const TimedPose& b = history[n - 1];
+		if (b.time <= a.time)
+			return;
 
-		this->chanValues[3] = rx;
-		this->chanValues[4] = ry;
-		this->chanValues[5] = rz;
+		double dt = std::min(age, this->extrapolateNs) / (double)(b.time - a.time);
+		TimedPose p = b;
+		for (size_t i = 0; i < TimedPose::VALUES; i++) {
+			if (TimedPose::isAngle(i))
+				p.v[i] = std::remainder(b.v[i] + angleDelta(a.v[i], b.v[i]) * dt, 360.0);
+			else
+				p.v[i] = b.v[i] + (b.v[i] - a.v[i]) * dt;
+		}
+		this->writePose(p, sample, values);
 	}
 
-	void readTransformation(unsigned char data[29]) {
-		auto x = this->hexToInt(data[11], data[12], data[13]) / 64.0 * 0.001 + this->transform[0];
-		auto y = this->hexToInt(data[17], data[18], data[19]) / 64.0 * 0.001 + this->transform[1];
-		auto z = this->hexToInt(data[14], data[15], data[16]) / 64.0 * 0.001 + this->transform[2];
-
-		this->chanValues[0] = x;
-		this->chanValues[1] = y;
-		this->chanValues[2] = z;
+	void applyDelay(int id, const Sample& sample, int64_t now, double* values)
+	{
+		TimedPose p;
+		if (this->histories[id] && this->histories[id]->sample(now - this->delayNs, this->delayHermite, p))
+			this->writePose(p, sample, values);
 	}
 
-	void readLenzData(unsigned char data[29]) {
-		auto lz = (double)this->hexToInt(data[20], data[21], data[22]) - (double)0x80000;
-		auto lf = (double)this->hexToInt(data[23], data[24], data[25]) - (double)0x80000;
-
-		// zoom
-		if (this->zoom_max == 0.0 || this->zoom_max < lz)
-			this->zoom_max = lz;
-		if (this->zoom_min == 0.0 || this->zoom_min > lz)
-			this->zoom_min = lz;
-
-		double zoom = 0.0;
-		if (this->zoom_max > 0.0 && this->zoom_min > 0.0 && this->zoom_max > this->zoom_min)
-			zoom = (this->zoom_max - lz) / (this->zoom_max - this->zoom_min);
-
-		// focus
-		if (this->focus_max == 0.0 || this->focus_max < lf)
-			this->focus_max = lf;
-		if (this->focus_min == 0.0 || this->focus_min > lf)
-			this->focus_min = lf;
-
-		double focus = 0.0;
-		if (this->focus_max > 0.0 && this->focus_min > 0.0 && this->focus_max > this->focus_min)
-			focus = (this->focus_max - lf) / (this->focus_max - this->focus_min);
-
-		this->chanValues[6] = zoom;
-		this->chanValues[7] = focus;
+	// the exposure ends at end, or at the newest frame when that is earlier
+	void applyShutter(int id, const Sample& sample, int64_t end, double* values)
+	{
+		if (!this->histories[id])
+			return;
+		const PoseHistory& history = *this->histories[id];
+		int64_t from, to;
+		if (!history.exposure(end, this->shutterNs, from, to))
+			return;
+		TimedPose p;
+		if (this->shutterMode == ShutterMean) {
+			if (history.mean(from, to, this->delayHermite, p))
+				this->writePose(p, sample, values);
+			return;
+		}
+		if (history.sample(from, this->delayHermite, p))
+			this->writePose(p, sample, values + this->shutterOffset);
+		if (history.sample(to, this->delayHermite, p))
+			this->writePose(p, sample, values + this->shutterOffset + 8);
 	}
 
-	void measureFps() {
-		this->now = time(NULL);
-		struct tm* pnow = localtime(&now);
-		int sec = pnow->tm_sec;
-		if (sec != this->last_sec) {
-			this->last_sec = sec;
-			this->chanValues[8] = (double)this->fps_counter;
-
-			if (this->fpsHistory.size() > 10) {
-				this->fpsHistory.erase(this->fpsHistory.begin());
-			}
-			this->fpsHistory.push_back((double)this->fps_counter);
-
-			if (this->fpsHistory.size() > 0) {
-				double sumHistory = std::accumulate(this->fpsHistory.begin(), this->fpsHistory.end(), 0);
-				auto avgHistory = sumHistory / this->fpsHistory.size();
-				this->chanValues[9] = avgHistory;
-			}
+	// every frame drained this cook goes to the history of its camera
+	void updateHistories(bool keep)
+	{
+		if (keep != (this->parHistory == 1) && this->mailbox.commands.push({ Command::History, { keep ? 1.0 : 0.0 } }))
+			this->parHistory = keep ? 1 : 0;
+		if (!keep)
+			return;
 
-			this->fps_counter = 0;
+		for (int id : this->outputIds) {
+			if (!this->histories[id])
+				this->histories[id].reset(new PoseHistory());
+			if (this->predictModel != Predictor::Off && !this->predictors[id])
+				this->predictors[id].reset(new Predictor());
+		}
+		for (const Sample& sample : this->slice) {
+			PoseHistory* history = this->histories[sample.frame[D1::CAMERA_ID]].get();
+			if (history)
+				history->push(sample.time, D1::decode(sample.frame));
 		}
-		this->fps_counter++;
 	}
 
-	int hexToInt(unsigned char d1, unsigned char d2, unsigned char d3)
+	// the port is opened in the background, execute never waits for the device
+	void start()
 	{
-		int v = (
-			_lrotl(d1, 24) & 0xff000000 |
-			_lrotl(d2, 16) & 0x00ff0000 |
-			_lrotl(d3, 8) & 0x0000ff00);
-		return v / 0x100;
-	}
+		this->port = PortRegistry::Instance().Subscribe(this->portname, &this->mailbox, this->reactor);
 
-	void stop()
-	{
-		this->running = false;
-		if (recv_thread.joinable())
-			recv_thread.join();
+		// per port settings, resend them to the new port
+		this->parInterbyte = -1;
+		this->parSilence = -1;
+		this->parLatency = -1;
+		this->parTuningSent = false;
+
+		// the new port counts from its own start
+		this->lastChecksumErrors = this->port->checksumErrors.load();
 	}
 
-	void close()
+	void stop()
 	{
-		this->serial.Close();
+		PortRegistry::Instance().Unsubscribe(this->port, &this->mailbox);
+		this->port.reset();
+		this->warning.clear();
 	}
 
 	void getGeneralInfo(CHOP_GeneralInfo* ginfo, const OP_Inputs* inputs, void* reserved1)
@@ -274,11 +370,100 @@ public:
 
 	bool getOutputInfo(CHOP_OutputInfo* info, const OP_Inputs* inputs, void* reserved1)
 	{
+		int timeslice = inputs->getParInt("Timeslice");
+		if (timeslice != this->parTimeslice && this->mailbox.commands.push({ Command::Timeslice, { (double)timeslice } }))
+			this->parTimeslice = timeslice;
+
+		int multi = inputs->getParInt("Multicamera");
+		if (multi != this->parMulticamera && this->mailbox.commands.push({ Command::MultiCamera, { (double)multi } }))
+			this->parMulticamera = multi;
+
+		this->stalePolicy = inputs->getParInt("Stalepolicy");
+		this->staleNs = (int64_t)(inputs->getParDouble("Stalethreshold") * 1e6);
+		this->extrapolateNs = (int64_t)(inputs->getParDouble("Extrapolatelimit") * 1e6);
+		this->predictModel = inputs->getParInt("Predict");
+		this->leadNs = (int64_t)(inputs->getParDouble("Lead") * 1e6);
+		this->kalmanNoise = inputs->getParDouble("Kalmannoise");
+		double delay = inputs->getParDouble("Delay");
+		if (inputs->getParInt("Delayunit") == 1)
+			delay = inputs->getParDouble("Fieldrate") > 0.0 ? delay * 1000.0 / inputs->getParDouble("Fieldrate") : 0.0;
+		this->delayNs = (int64_t)(delay * 1e6);
+		this->delayHermite = inputs->getParInt("Delayinterp") == 1;
+		this->shutterMode = inputs->getParInt("Shutter");
+		double fieldRate = inputs->getParDouble("Fieldrate");
+		this->shutterNs = fieldRate > 0.0 ? (int64_t)(inputs->getParDouble("Shutterangle") / 360.0 / fieldRate * 1e9) : 0;
+
+		// there is no cook time to predict a timeslice sample to
+		this->predictIgnored = timeslice && !multi && this->predictModel != Predictor::Off;
+		if (this->predictIgnored)
+			this->predictModel = Predictor::Off;
+
+		this->updatePoseNames(inputs);
+		this->updateOutputIds(inputs, multi != 0);
+		if (multi)
+			timeslice = 0;
+
+		// drain every packet received since the last cook
+		this->slice.clear();
+		Sample sample;
+		while (this->mailbox.slices.pop(sample)) {
+			this->slice.push_back(sample);
+		}
+		this->updateHistories(this->stalePolicy == Extrapolate || this->predictModel != Predictor::Off || this->delayNs > 0 ||
+			this->shutterMode != ShutterOff);
+		if (!timeslice)
+			this->slice.clear();
+
 		info->numSamples = 1;
 		info->numChannels = this->chanNames.size();
+
+		if (timeslice && this->slice.size()) {
+			info->numSamples = this->slice.size();
+			double rate = this->slice.back().fpsavg;
+			if (rate > 0.0)
+				info->sampleRate = (float)rate;
+		}
 		return true;
 	}
 
+	void updateOutputIds(const OP_Inputs* inputs, bool multi)
+	{
+		this->outputIds.clear();
+
+		if (!multi) {
+			this->outputIds.push_back(std::min(std::max(inputs->getParInt("Cameraid"), 0), 255));
+			this->chanNames = this->poseNames;
+			return;
+		}
+
+		// configured list, or every id seen on the port so far
+		const char* p = inputs->getParString("Cameraids");
+		while (*p) {
+			char* end;
+			long id = strtol(p, &end, 10);
+			if (end == p) {
+				p++;
+				continue;
+			}
+			if (id >= 0 && id <= 255 && std::find(this->outputIds.begin(), this->outputIds.end(), (int)id) == this->outputIds.end())
+				this->outputIds.push_back((int)id);
+			p = end;
+		}
+		if (this->outputIds.empty()) {
+			for (int id = 0; id < (int)this->mailbox.cameras.size(); id++) {
+				if (this->mailbox.cameras[id].seen.load(std::memory_order_relaxed))
+					this->outputIds.push_back(id);
+			}
+		}
+
+		this->chanNames.clear();
+		for (int id : this->outputIds) {
+			for (const auto& name : this->poseNames) {
+				this->chanNames.push_back("cam" + std::to_string(id) + "_" + name);
+			}
+		}
+	}
+
 	void getChannelName(int32_t index, OP_String *name, const OP_Inputs* inputs, void* reserved1)
 	{
 		name->setString(this->chanNames.at(index).c_str());
@@ -286,36 +471,263 @@ public:
 
 	void execute(CHOP_Output* output, const OP_Inputs* inputs, void* reserved)
 	{
+		TRACE_SCOPE(Trace::Execute, output->numSamples);
+
 		inputs->getParDouble3("T", this->transform[0], this->transform[1], this->transform[2]);
 		inputs->getParDouble3("R", this->rotate[0], this->rotate[1], this->rotate[2]);
 
+		int id = inputs->getParInt("Cameraid");
+		if (id != this->parCameraid && this->mailbox.commands.push({ Command::CameraId, { (double)id } }))
+			this->parCameraid = id;
+
+		int interbyte = inputs->getParInt("Interbyte");
+		if (interbyte != this->parInterbyte && this->mailbox.commands.push({ Command::InterByteTimeout, { (double)interbyte } }))
+			this->parInterbyte = interbyte;
+
+		int silence = inputs->getParInt("Silencetimeout");
+		if (silence != this->parSilence && this->mailbox.commands.push({ Command::SilenceTimeout, { (double)silence } }))
+			this->parSilence = silence;
+
+		int latency = inputs->getParInt("Latencytimer");
+		if (latency != this->parLatency && this->mailbox.commands.push({ Command::LatencyTimer, { (double)latency } }))
+			this->parLatency = latency;
+
+		ThreadTuning tuning;
+		tuning.priority = inputs->getParInt("Threadpriority");
+		tuning.affinity = (uint64_t)std::max(inputs->getParInt("Affinity"), 0);
+		tuning.task = inputs->getParInt("Mmcss");
+		if ((!this->parTuningSent || !(tuning == this->parTuning)) &&
+			this->mailbox.commands.push({ Command::Tuning, { (double)tuning.priority, (double)tuning.affinity, (double)tuning.task } })) {
+			this->parTuning = tuning;
+			this->parTuningSent = true;
+		}
+
+		// one log for the process, the last node to change it wins
+		std::string logfile = inputs->getParString("Logfile");
+		if (logfile != this->parLogfile) {
+			Logger::Instance().SetFile(logfile);
+			this->parLogfile = logfile;
+		}
+
+		// process wide as well, saved on the Save Trace pulse
+		int trace = inputs->getParInt("Trace");
+		if (trace != this->parTrace) {
+			Trace::NameThread("cook");
+			Trace::Instance().Enable(trace != 0);
+			this->parTrace = trace;
+		}
+		this->traceFile = inputs->getParString("Tracefile");
+
 		std::string name = inputs->getParString("Portname");
+#ifdef _WIN32
 		std::transform(name.cbegin(), name.cend(), name.begin(), toupper);
+#endif
 
-		this->cameraid = inputs->getParInt("Cameraid");
+		bool reactor = inputs->getParInt("Reactor") != 0;
 
-		if (this->portname != name) {
+		if (this->portname != name || this->reactor != reactor)
 			this->stop();
-			this->close();
-		}
 		this->portname = name;
+		this->reactor = reactor;
 
 		if (!this->portname.size())
 			return;
 
-		if (!this->running) {
-			if (!this->open())
-				return;
+		if (!this->port)
 			this->start();
-		}
 
-		for (int i = 0; i < this->chanNames.size(); i++) {
+		this->updateWarning(inputs->getParInt("Multicamera") != 0);
+
+		this->values.resize(this->poseNames.size());
+		double* values = this->values.data();
+		int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+
+		if (this->slice.size() == output->numSamples) {
+			size_t n = this->slice.size();
+			this->sliceColumns.resize(n * D1::FIELDS);
+			double* cols[D1::FIELDS];
+			for (int f = 0; f < D1::FIELDS; f++) {
+				cols[f] = this->sliceColumns.data() + f * n;
+			}
+			D1::decodeBatch(this->slice[0].frame, n, sizeof(Sample), cols);
+
+			// Delay and shutter are applied per sample, relative to the
+			// sample's own time. Every sample is fresh, so the stale policy
+			// only applies to cooks without new frames.
+			int camera = this->outputIds[0];
+			std::fill(this->values.begin(), this->values.end(), 0.0);
 			for (int j = 0; j < output->numSamples; j++) {
-				output->channels[i][j] = this->chanValues.at(i);
+				const Sample& sample = this->slice[j];
+				D1::Pose data{
+					cols[D1::X][j], cols[D1::Height][j], cols[D1::Y][j],
+					cols[D1::Tilt][j], cols[D1::Pan][j], cols[D1::Roll][j],
+					(int32_t)cols[D1::Zoom][j], (int32_t)cols[D1::Focus][j],
+				};
+				this->readSample(sample, data, values);
+				if (this->delayNs > 0)
+					this->applyDelay(camera, sample, sample.time, values);
+				if (this->shutterMode != ShutterOff)
+					this->applyShutter(camera, sample, sample.time - this->delayNs, values);
+				values[AGE] = (now - sample.time) / 1e6;
+				values[VALID] = 1.0;
+				for (int i = 0; i < this->poseNames.size(); i++) {
+					output->channels[i][j] = values[i];
+				}
+			}
+			TRACE_MARK(Trace::Consume, values[AGE]);
+			return;
+		}
+
+		for (int k = 0; k < this->outputIds.size(); k++) {
+			Camera& cam = this->mailbox.cameras[this->outputIds[k]];
+			cam.samples.update();
+			const Sample& sample = cam.samples.readBuffer();
+			if (sample.frame[0] == D1::SYNC) {
+				this->readSample(sample, D1::decode(sample.frame), values);
+				int64_t age = now - sample.time;
+				bool stale = this->staleNs > 0 && age > this->staleNs;
+				if (this->predictOffset >= 0)
+					this->applyPrediction(this->outputIds[k], sample, now, !stale && this->delayNs <= 0, values);
+				if (this->delayNs > 0)
+					this->applyDelay(this->outputIds[k], sample, now, values);
+				if (this->shutterMode != ShutterOff)
+					this->applyShutter(this->outputIds[k], sample, now - this->delayNs, values);
+				if (stale)
+					this->applyStalePolicy(this->outputIds[k], sample, age, values);
+				values[AGE] = age / 1e6;
+				values[VALID] = stale ? 0.0 : 1.0;
+				TRACE_MARK(Trace::Consume, values[AGE]);
+			}
+			else
+				std::fill(this->values.begin(), this->values.end(), 0.0);
+
+			float** channels = output->channels + k * this->poseNames.size();
+			for (int i = 0; i < this->poseNames.size(); i++) {
+				for (int j = 0; j < output->numSamples; j++) {
+					channels[i][j] = values[i];
+				}
 			}
 		}
 	}
 
+	// Info CHOP channels, in this order
+	enum Info {
+		TimesliceOverflow, Packets, SerialWakeups,
+		BacklogAvg, BacklogMax, ConnectionState, Reconnects,
+		WakeLatencyP50, WakeLatencyP99, WakeLatencyMax, ThreadTuningApplied, LatencyTimerMs,
+		BytesReceived, FramesAccepted, ChecksumErrors, IdMismatches, Resyncs, BytesDiscarded, ReadErrors,
+		LogDropped, TraceDropped,
+		INFO_COUNT
+	};
+
+	int32_t getNumInfoCHOPChans(void* reserved1)
+	{
+		return INFO_COUNT;
+	}
+
+	void getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1)
+	{
+		static const char* names[INFO_COUNT] = {
+			"timeslice_overflow", "packets", "serial_wakeups",
+			"wakeup_backlog_avg_bytes", "wakeup_backlog_max_bytes", "connection_state", "reconnects",
+			"wakeup_latency_p50_us", "wakeup_latency_p99_us", "wakeup_latency_max_us", "thread_tuning", "latency_timer_ms",
+			"bytes_received", "frames_accepted", "checksum_errors", "id_mismatches", "resyncs", "bytes_discarded", "read_errors",
+			"log_dropped", "trace_dropped",
+		};
+		chan->name->setString(names[index]);
+		chan->value = (float)this->infoValue(index);
+	}
+
+	double infoValue(int index)
+	{
+		SharedPort* p = this->port.get();
+		switch (index) {
+		case TimesliceOverflow: return (double)this->mailbox.sliceOverflow.load();
+		case Packets: return (double)this->mailbox.packets.load();
+		// wakeups / packets is the number to watch, ideally close to 1
+		case SerialWakeups: return p ? (double)p->Wakeups() : 0.0;
+		// bytes already queued per wakeup, with USB adapters about one
+		// transfer, set by the latency timer
+		case BacklogAvg: return p ? p->BacklogAvg() : 0.0;
+		case BacklogMax: return p ? p->BacklogMax() : 0.0;
+		// 0: no port, 1: waiting for the device, 2: connected
+		case ConnectionState: return p ? (double)p->GetState() : 0.0;
+		case Reconnects: return p ? (double)p->Reconnects() : 0.0;
+		// how late the reader thread runs after a timed wait, the number
+		// the thread tuning is meant to bring down
+		case WakeLatencyP50: return p ? p->Latency().percentile(0.5) : 0.0;
+		case WakeLatencyP99: return p ? p->Latency().percentile(0.99) : 0.0;
+		case WakeLatencyMax: return p ? p->Latency().maximum() : 0.0;
+		// 1 applied, 0 refused by the OS (privileges), -1 not applied yet
+		case ThreadTuningApplied: return p ? (double)p->TuningApplied() : -1.0;
+		// USB adapter latency timer, -1 when the port has none
+		case LatencyTimerMs: return p ? (double)p->LatencyTimer() : -1.0;
+		case BytesReceived: return p ? (double)p->bytesReceived.load() : 0.0;
+		case FramesAccepted: return p ? (double)p->framesAccepted.load() : 0.0;
+		case ChecksumErrors: return p ? (double)p->checksumErrors.load() : 0.0;
+		// frames for other camera ids, normal when nodes share a port
+		case IdMismatches: return (double)this->mailbox.idMismatches.load();
+		case Resyncs: return p ? (double)p->resyncs.load() : 0.0;
+		case BytesDiscarded: return p ? (double)p->discarded.load() : 0.0;
+		case ReadErrors: return p ? (double)p->readErrors.load() : 0.0;
+		// process wide, records lost to a full log ring
+		case LogDropped: return (double)Logger::Instance().Dropped();
+		case TraceDropped: return (double)Trace::Instance().Dropped();
+		}
+		return 0.0;
+	}
+
+	void getWarningString(OP_String* warning, void* reserved1)
+	{
+		if (!this->warning.empty())
+			warning->setString(this->warning.c_str());
+	}
+
+	// what getWarningString reports, refreshed once per cook from the counters
+	void updateWarning(bool multi)
+	{
+		this->warning.clear();
+		if (!this->port)
+			return;
+
+		int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		const int64_t window = 1000000000LL;
+
+		uint64_t checksum = this->port->checksumErrors.load();
+		if (checksum != this->lastChecksumErrors) {
+			this->lastChecksumErrors = checksum;
+			this->checksumTime = now;
+		}
+		uint64_t packets = this->mailbox.packets.load();
+		if (packets != this->lastPackets) {
+			this->lastPackets = packets;
+			this->packetTime = now;
+		}
+		uint64_t mismatches = this->mailbox.idMismatches.load();
+		if (mismatches != this->lastMismatches) {
+			this->lastMismatches = mismatches;
+			this->mismatchTime = now;
+		}
+
+		if (this->port->GetState() != SharedPort::Connected) {
+			this->warning = this->port->Reconnects() || this->lastPackets ?
+				"Lost " + this->portname + ", reconnecting" :
+				"Waiting for " + this->portname;
+		}
+		else if (now - this->checksumTime < window) {
+			this->warning = "Checksum errors on " + this->portname + ", check baud rate and wiring";
+		}
+		else if (!multi && now - this->mismatchTime < window && now - this->packetTime >= window) {
+			this->warning = "No frames for camera ID " + std::to_string(this->parCameraid) +
+				", the port carries camera ID " + std::to_string(this->mailbox.lastOtherId.load());
+		}
+		else if (this->predictIgnored) {
+			this->warning = "Predict is off in timeslice mode, turn off Timeslice to predict";
+		}
+	}
+
 	void setupParameters(OP_ParameterManager* manager, void *reserved1)
 	{
 		{
@@ -325,6 +737,13 @@ public:
 			OP_ParAppendResult res = manager->appendString(sp);
 			assert(res == OP_ParAppendResult::Success);
 		}
+		{
+			OP_NumericParameter np;
+			np.name = "Reactor";
+			np.label = "Shared I/O Thread";
+			OP_ParAppendResult res = manager->appendToggle(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
 		{
 			OP_NumericParameter np;
 			np.name = "Cameraid";
@@ -335,6 +754,20 @@ public:
 			OP_ParAppendResult res = manager->appendInt(np);
 			assert(res == OP_ParAppendResult::Success);
 		}
+		{
+			OP_NumericParameter np;
+			np.name = "Multicamera";
+			np.label = "Multi Camera";
+			OP_ParAppendResult res = manager->appendToggle(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Cameraids";
+			sp.label = "Camera IDs";
+			OP_ParAppendResult res = manager->appendString(sp);
+			assert(res == OP_ParAppendResult::Success);
+		}
 		{
 			OP_NumericParameter np;
 			np.name = "T";
@@ -349,6 +782,275 @@ public:
 			OP_ParAppendResult res = manager->appendXYZ(np);
 			assert(res == OP_ParAppendResult::Success);
 		}
+		// One sample per frame since the last cook. Delay and Shutter apply
+		// to each sample at its own time; Predict is off, with a warning.
+		{
+			OP_NumericParameter np;
+			np.name = "Timeslice";
+			np.label = "Timeslice";
+			OP_ParAppendResult res = manager->appendToggle(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Ratestats";
+			np.label = "Rate Statistics";
+			OP_ParAppendResult res = manager->appendToggle(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Derivatives";
+			sp.label = "Derivatives";
+			sp.defaultValue = "Off";
+			const char* names[] = { "Off", "Velocity", "Acceleration" };
+			const char* labels[] = { "Off", "Velocity", "Velocity and Acceleration" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Derivwindow";
+			np.label = "Derivative Window";
+			np.defaultValues[0] = 5.0;
+			np.minValues[0] = 2.0;
+			np.maxValues[0] = (double)Differentiator::MAX_WINDOW;
+			np.clampMins[0] = true;
+			np.clampMaxes[0] = true;
+			np.minSliders[0] = 2.0;
+			np.maxSliders[0] = (double)Differentiator::MAX_WINDOW;
+			OP_ParAppendResult res = manager->appendInt(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Stalethreshold";
+			np.label = "Stale Threshold (ms)";
+			np.defaultValues[0] = 100.0;
+			np.minValues[0] = 0.0;
+			np.clampMins[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 1000.0;
+			OP_ParAppendResult res = manager->appendFloat(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Stalepolicy";
+			sp.label = "Stale Policy";
+			sp.defaultValue = "Hold";
+			const char* names[] = { "Hold", "Zero", "Extrapolate" };
+			const char* labels[] = { "Hold", "Zero", "Extrapolate" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Extrapolatelimit";
+			np.label = "Extrapolate Limit (ms)";
+			np.defaultValues[0] = 100.0;
+			np.minValues[0] = 0.0;
+			np.clampMins[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 1000.0;
+			OP_ParAppendResult res = manager->appendFloat(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Predict";
+			sp.label = "Predict";
+			sp.defaultValue = "Off";
+			const char* names[] = { "Off", "Velocity", "Acceleration", "Kalman" };
+			const char* labels[] = { "Off", "Constant Velocity", "Constant Acceleration", "Kalman" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 4, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Lead";
+			np.label = "Lead (ms)";
+			np.defaultValues[0] = 20.0;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 100.0;
+			OP_ParAppendResult res = manager->appendFloat(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Kalmannoise";
+			np.label = "Kalman Process Noise";
+			np.defaultValues[0] = 1.0;
+			np.minValues[0] = 0.0;
+			np.clampMins[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 10.0;
+			OP_ParAppendResult res = manager->appendFloat(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Delay";
+			np.label = "Delay";
+			np.minValues[0] = 0.0;
+			np.clampMins[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 200.0;
+			OP_ParAppendResult res = manager->appendFloat(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Delayunit";
+			sp.label = "Delay Unit";
+			sp.defaultValue = "Milliseconds";
+			const char* names[] = { "Milliseconds", "Fields" };
+			const char* labels[] = { "Milliseconds", "Fields" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Fieldrate";
+			np.label = "Field Rate (Hz)";
+			np.defaultValues[0] = 50.0;
+			np.minSliders[0] = 24.0;
+			np.maxSliders[0] = 120.0;
+			OP_ParAppendResult res = manager->appendFloat(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Delayinterp";
+			sp.label = "Delay Interpolation";
+			sp.defaultValue = "Hermite";
+			const char* names[] = { "Linear", "Hermite" };
+			const char* labels[] = { "Linear", "Hermite" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Shutter";
+			sp.label = "Shutter";
+			sp.defaultValue = "Off";
+			const char* names[] = { "Off", "Mean", "Openclose" };
+			const char* labels[] = { "Off", "Mean Pose", "Open and Close" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Shutterangle";
+			np.label = "Shutter Angle";
+			np.defaultValues[0] = 180.0;
+			np.minValues[0] = 0.0;
+			np.maxValues[0] = 360.0;
+			np.clampMins[0] = true;
+			np.clampMaxes[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 360.0;
+			OP_ParAppendResult res = manager->appendFloat(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Interbyte";
+			np.label = "Inter-byte Timeout (ms)";
+			np.defaultValues[0] = 0.0;
+			np.minValues[0] = 0.0;
+			np.clampMins[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 20.0;
+			OP_ParAppendResult res = manager->appendInt(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Silencetimeout";
+			np.label = "Silence Timeout (ms)";
+			np.defaultValues[0] = 2000.0;
+			np.minValues[0] = 0.0;
+			np.clampMins[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 10000.0;
+			OP_ParAppendResult res = manager->appendInt(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Latencytimer";
+			np.label = "USB Latency Timer (ms)";
+			np.defaultValues[0] = 0.0;
+			np.minValues[0] = 0.0;
+			np.maxValues[0] = 255.0;
+			np.clampMins[0] = true;
+			np.clampMaxes[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 16.0;
+			OP_ParAppendResult res = manager->appendInt(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Threadpriority";
+			sp.label = "Thread Priority";
+			sp.defaultValue = "Normal";
+			const char* names[] = { "Normal", "Abovenormal", "Highest", "Timecritical" };
+			const char* labels[] = { "Normal", "Above Normal", "Highest", "Time Critical" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 4, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Affinity";
+			np.label = "CPU Affinity Mask";
+			np.defaultValues[0] = 0.0;
+			np.minValues[0] = 0.0;
+			np.clampMins[0] = true;
+			np.minSliders[0] = 0.0;
+			np.maxSliders[0] = 255.0;
+			OP_ParAppendResult res = manager->appendInt(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Mmcss";
+			sp.label = "MMCSS Task";
+			sp.defaultValue = "None";
+			const char* names[] = { "None", "Proaudio", "Audio", "Games", "Playback", "Capture" };
+			const char* labels[] = { "None", "Pro Audio", "Audio", "Games", "Playback", "Capture" };
+			OP_ParAppendResult res = manager->appendMenu(sp, 6, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Logfile";
+			sp.label = "Log File";
+			OP_ParAppendResult res = manager->appendFile(sp);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Trace";
+			np.label = "Trace";
+			OP_ParAppendResult res = manager->appendToggle(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_StringParameter sp;
+			sp.name = "Tracefile";
+			sp.label = "Trace File";
+			OP_ParAppendResult res = manager->appendFile(sp);
+			assert(res == OP_ParAppendResult::Success);
+		}
+		{
+			OP_NumericParameter np;
+			np.name = "Savetrace";
+			np.label = "Save Trace";
+			OP_ParAppendResult res = manager->appendPulse(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
 		{
 			OP_NumericParameter np;
 			np.name = "Zoomreset";
@@ -368,12 +1070,13 @@ public:
 	void pulsePressed(const char* name, void* reserved1)
 	{
 		if (!strcmp(name, "Zoomreset")) {
-			this->zoom_max = 0;
-			this->zoom_min = 0;
+			this->mailbox.commands.push({ Command::ZoomReset, {} });
 		}
 		if (!strcmp(name, "Focusreset")) {
-			this->focus_max = 0;
-			this->focus_min = 0;
+			this->mailbox.commands.push({ Command::FocusReset, {} });
+		}
+		if (!strcmp(name, "Savetrace")) {
+			Trace::Instance().Save(this->traceFile);
 		}
 	}
 
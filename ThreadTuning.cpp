@@ -0,0 +1,99 @@
+#include "ThreadTuning.hpp"
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+
+static const char* TASKS[] = { nullptr, "Pro Audio", "Audio", "Games", "Playback", "Capture" };
+
+// MMCSS registration of the calling thread
+static thread_local HANDLE mmcss = NULL;
+static thread_local int mmcssTask = ThreadTuning::NoTask;
+
+bool applyThreadTuning(const ThreadTuning& tuning) {
+	bool ok = true;
+	HANDLE self = GetCurrentThread();
+
+	static const int PRIORITIES[] = {
+		THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_ABOVE_NORMAL,
+		THREAD_PRIORITY_HIGHEST, THREAD_PRIORITY_TIME_CRITICAL,
+	};
+	int p = tuning.priority >= 0 && tuning.priority <= ThreadTuning::TimeCritical ? tuning.priority : 0;
+	ok &= SetThreadPriority(self, PRIORITIES[p]) != FALSE;
+
+	DWORD_PTR mask = (DWORD_PTR)tuning.affinity;
+	if (mask == 0) {
+		DWORD_PTR system;
+		GetProcessAffinityMask(GetCurrentProcess(), &mask, &system);
+	}
+	ok &= SetThreadAffinityMask(self, mask) != 0;
+
+	if (tuning.task != mmcssTask) {
+		if (mmcss) {
+			AvRevertMmThreadCharacteristics(mmcss);
+			mmcss = NULL;
+		}
+		mmcssTask = ThreadTuning::NoTask;
+		if (tuning.task > ThreadTuning::NoTask && tuning.task <= ThreadTuning::Capture) {
+			DWORD index = 0;
+			mmcss = AvSetMmThreadCharacteristicsA(TASKS[tuning.task], &index);
+			if (mmcss)
+				mmcssTask = tuning.task;
+			else
+				ok = false;
+		}
+	}
+	return ok;
+}
+
+#else
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+bool applyThreadTuning(const ThreadTuning& tuning) {
+	bool ok = true;
+	pthread_t self = pthread_self();
+
+	sched_param param = {};
+	int policy = SCHED_OTHER;
+	if (tuning.priority == ThreadTuning::Highest) {
+		policy = SCHED_FIFO;
+		param.sched_priority = 10;
+	}
+	else if (tuning.priority == ThreadTuning::TimeCritical) {
+		// still below the kernel's threaded interrupt handlers
+		policy = SCHED_FIFO;
+		param.sched_priority = 49;
+	}
+	ok &= pthread_setschedparam(self, policy, &param) == 0;
+
+#ifdef __linux__
+	// nice is per thread on Linux
+	if (policy == SCHED_OTHER) {
+		int nice = tuning.priority == ThreadTuning::AboveNormal ? -5 : 0;
+		ok &= setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) == 0;
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	int cpus = (int)std::thread::hardware_concurrency();
+	for (int i = 0; i < CPU_SETSIZE && i < 64; i++) {
+		if (tuning.affinity ? (tuning.affinity >> i) & 1 : i < (cpus > 0 ? cpus : CPU_SETSIZE))
+			CPU_SET(i, &set);
+	}
+	ok &= pthread_setaffinity_np(self, sizeof(set), &set) == 0;
+#endif
+
+	return ok;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// Scheduling of an I/O thread, applied by the thread to itself.
+struct ThreadTuning {
+	enum Priority { Normal, AboveNormal, Highest, TimeCritical };
+	// MMCSS task classes, Windows only
+	enum Task { NoTask, ProAudio, Audio, Games, Playback, Capture };
+
+	int priority = Normal;
+	uint64_t affinity = 0;	// CPU bit mask, 0 = any CPU
+	int task = NoTask;
+
+	bool operator==(const ThreadTuning& o) const {
+		return priority == o.priority && affinity == o.affinity && task == o.task;
+	}
+};
+
+// Windows: SetThreadPriority, SetThreadAffinityMask and MMCSS.
+// POSIX: Highest and TimeCritical run SCHED_FIFO, AboveNormal lowers the
+// nice value, affinity uses pthread_setaffinity_np where available.
+// Returns false when the OS refused part of it, usually for lack of
+// privileges; whatever could be applied stays applied.
+bool applyThreadTuning(const ThreadTuning& tuning);
@@ -0,0 +1,177 @@
+#include "Trace.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char* NAMES[Trace::ZONES] = { "read", "service", "frame", "publish", "execute", "consume" };
+
+std::atomic<bool> Trace::enabled{ false };
+
+// the calling thread's buffer, handed back when the thread exits
+struct TraceLocal {
+	Trace::Buffer* buffer = nullptr;
+	std::string name;
+
+	~TraceLocal() {
+		if (buffer)
+			buffer->owned = false;
+	}
+};
+
+static thread_local TraceLocal local;
+
+Trace& Trace::Instance()
+{
+	static Trace trace;
+	return trace;
+}
+
+int64_t Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::NameThread(const std::string& name)
+{
+	local.name = name;
+	if (local.buffer) {
+		Trace& trace = Instance();
+		std::lock_guard<std::mutex> lock(trace.mutex);
+		local.buffer->name = name;
+	}
+}
+
+void Trace::Enable(bool on)
+{
+	if (!on) {
+		enabled = false;
+		return;
+	}
+	if (enabled)
+		return;
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Event e;
+	for (auto& b : this->buffers) {
+		while (b->events.pop(e)) {
+		}
+		b->dropped = 0;
+	}
+	enabled = true;
+}
+
+uint64_t Trace::Dropped()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	uint64_t n = 0;
+	for (auto& b : this->buffers) {
+		n += b->dropped;
+	}
+	return n;
+}
+
+Trace::Buffer* Trace::acquire()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Buffer* buffer = nullptr;
+	for (auto& b : this->buffers) {
+		if (!b->owned) {
+			buffer = b.get();
+			break;
+		}
+	}
+	if (!buffer) {
+		this->buffers.emplace_back(new Buffer());
+		buffer = this->buffers.back().get();
+		buffer->tid = (uint32_t)this->buffers.size();
+	}
+	buffer->owned = true;
+	buffer->name = local.name.size() ? local.name : "thread " + std::to_string(buffer->tid);
+
+	local.buffer = buffer;
+	return buffer;
+}
+
+void Trace::record(Zone zone, int64_t time, int64_t duration, double value)
+{
+	Buffer* buffer = local.buffer ? local.buffer : this->acquire();
+	if (!buffer->events.push({ time, duration, zone, value }))
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// a string as a JSON string literal, thread names come from the user
+static std::string jsonString(const std::string& s)
+{
+	std::string out = "\"";
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += (char)c;
+		} else if (c < 0x20) {
+			char esc[8];
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			out += esc;
+		} else {
+			out += (char)c;
+		}
+	}
+	return out + "\"";
+}
+
+// JSON has no nan or inf
+static std::string jsonNumber(double v)
+{
+	if (!std::isfinite(v))
+		return "null";
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%g", v);
+	return buf;
+}
+
+bool Trace::Save(const std::string& path)
+{
+	if (path.empty())
+		return false;
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f)
+		return false;
+
+#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = (unsigned long)getpid();
+#endif
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	const char* sep = "";
+	for (auto& b : this->buffers) {
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%u,\"args\":{\"name\":%s}}",
+			sep, pid, b->tid, jsonString(b->name).c_str());
+		sep = ",\n";
+
+		Event e;
+		while (b->events.pop(e)) {
+			// trace event times are in us
+			std::string name = jsonString(NAMES[e.zone]);
+			std::string value = jsonNumber(e.value);
+			if (e.duration < 0)
+				fprintf(f, ",\n{\"name\":%s,\"cat\":\"shotoku\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%u,\"args\":{\"value\":%s}}",
+					name.c_str(), e.time / 1000.0, pid, b->tid, value.c_str());
+			else
+				fprintf(f, ",\n{\"name\":%s,\"cat\":\"shotoku\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%u,\"args\":{\"value\":%s}}",
+					name.c_str(), e.time / 1000.0, e.duration / 1000.0, pid, b->tid, value.c_str());
+		}
+	}
+	fprintf(f, "\n]}\n");
+	bool ok = !ferror(f);
+	return fclose(f) == 0 && ok;
+}
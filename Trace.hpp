@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LockFree.hpp"
+
+// Optional timing trace of the path from the serial line to the cook,
+// saved as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+// Every thread records into a lock-free buffer of its own. While tracing
+// is off a trace point is one relaxed load; defining SHOTOKU_NO_TRACE
+// compiles them out entirely.
+class Trace {
+public:
+	enum Zone {
+		Read,		// Serial::Read returned, value = bytes
+		Service,	// one read chunk parsed and delivered
+		Frame,		// frame accepted, value = camera id
+		Publish,	// sample published to a node, value = camera id
+		Execute,	// a cook of the node
+		Consume,	// the cook read a camera's sample, value = its age in ms
+		ZONES
+	};
+
+	static Trace& Instance();
+
+	Trace() = default;
+	Trace(const Trace&) = delete;
+
+	static bool On() { return enabled.load(std::memory_order_relaxed); }
+
+	// turning it on starts from empty buffers
+	void Enable(bool on);
+	// events recorded since it was turned on or last saved, false if the file could not be written
+	bool Save(const std::string& path);
+	// events lost to full buffers
+	uint64_t Dropped();
+
+	// instant event at the current time
+	static void Mark(Zone zone, double value = 0.0) {
+		if (On())
+			Instance().record(zone, now(), -1, value);
+	}
+	// instant event at a steady_clock ns time the caller already has
+	static void MarkAt(int64_t time, Zone zone, double value = 0.0) {
+		if (On())
+			Instance().record(zone, time, -1, value);
+	}
+
+	// how the calling thread shows up in the trace, set it before the first event
+	static void NameThread(const std::string& name);
+
+	// an event lasting from construction to destruction
+	class Scope {
+	public:
+		explicit Scope(Zone zone, double value = 0.0) : zone(zone), value(value), start(On() ? now() : -1) {}
+		~Scope() {
+			if (start >= 0 && On())
+				Instance().record(zone, start, now() - start, value);
+		}
+		Scope(const Scope&) = delete;
+
+	private:
+		Zone zone;
+		double value;
+		int64_t start;
+	};
+
+	static int64_t now();
+
+private:
+	friend struct TraceLocal;
+
+	struct Event {
+		int64_t time;		// steady_clock ns
+		int64_t duration;	// ns, -1 for an instant
+		int32_t zone;
+		double value;
+	};
+
+	struct Buffer {
+		SpscQueue<Event, 16384> events;
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<bool> owned{ true };
+		std::string name;
+		uint32_t tid = 0;
+	};
+
+	static std::atomic<bool> enabled;
+
+	// buffers are never freed, a thread that exits hands its buffer to the next new one
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Buffer>> buffers;
+
+	void record(Zone zone, int64_t time, int64_t duration, double value);
+	Buffer* acquire();
+};
+
+#ifdef SHOTOKU_NO_TRACE
+#define TRACE_SCOPE(zone, value)
+#define TRACE_MARK(zone, value)
+#define TRACE_MARK_AT(time, zone, value)
+#else
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(zone, value) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(zone, value)
+#define TRACE_MARK(zone, value) Trace::Mark(zone, value)
+#define TRACE_MARK_AT(time, zone, value) Trace::MarkAt(time, zone, value)
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Scheduling latency of one thread, measured like cyclictest: how long
+// after the deadline of a timed wait the thread actually runs again.
+// Written by the measured thread only, read from any thread. Bins are
+// 1 us wide up to 64 us, then 32 per power of two, so a percentile is
+// within about 3% of the real value.
+class WakeLatency {
+public:
+	static const size_t LINEAR = 64;
+	static const size_t SUB = 32;
+	// up to 2^26 us, about a minute, the last bin takes the rest
+	static const size_t BINS = LINEAR + (26 - 6) * SUB;
+
+	WakeLatency() { reset(); }
+
+	// not while the measured thread may add
+	void reset() {
+		for (auto& b : this->hist)
+			b.store(0, std::memory_order_relaxed);
+		this->samples.store(0, std::memory_order_relaxed);
+		this->sum.store(0, std::memory_order_relaxed);
+		this->max.store(0, std::memory_order_relaxed);
+	}
+
+	// ns past the deadline, an early return counts as 0
+	void add(int64_t lateNs) {
+		uint64_t ns = lateNs > 0 ? (uint64_t)lateNs : 0;
+		this->hist[bin(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+		this->samples.fetch_add(1, std::memory_order_relaxed);
+		this->sum.fetch_add(ns, std::memory_order_relaxed);
+		if (ns > this->max.load(std::memory_order_relaxed))
+			this->max.store(ns, std::memory_order_relaxed);
+	}
+
+	// steady_clock ns, the clock deadlines are measured against
+	static int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	uint64_t count() const { return this->samples.load(std::memory_order_relaxed); }
+
+	// us
+	double avg() const {
+		uint64_t n = this->count();
+		return n ? this->sum.load(std::memory_order_relaxed) / 1000.0 / n : 0.0;
+	}
+	double maximum() const { return this->max.load(std::memory_order_relaxed) / 1000.0; }
+	// upper edge of the bin holding the p-th fraction, p in 0-1, at most the maximum
+	double percentile(double p) const {
+		uint64_t counts[BINS];
+		uint64_t total = 0;
+		for (size_t i = 0; i < BINS; i++) {
+			counts[i] = this->hist[i].load(std::memory_order_relaxed);
+			total += counts[i];
+		}
+		if (total == 0)
+			return 0.0;
+
+		uint64_t rank = (uint64_t)(p * total + 0.5);
+		if (rank < 1)
+			rank = 1;
+		uint64_t seen = 0;
+		size_t i = 0;
+		for (; i < BINS - 1; i++) {
+			seen += counts[i];
+			if (seen >= rank)
+				break;
+		}
+		double edge = (double)upper(i);
+		double top = this->maximum();
+		return edge < top ? edge : top;
+	}
+
+private:
+	std::atomic<uint64_t> hist[BINS];
+	std::atomic<uint64_t> samples;
+	std::atomic<uint64_t> sum;	// ns
+	std::atomic<uint64_t> max;	// ns
+
+	static size_t bin(uint64_t us) {
+		if (us < LINEAR)
+			return (size_t)us;
+		size_t e = 6;	// 2^e <= us
+		while (e < 63 && (us >> (e + 1)))
+			e++;
+		size_t b = LINEAR + (e - 6) * SUB + (size_t)((us >> (e - 5)) - SUB);
+		return b < BINS ? b : BINS - 1;
+	}
+
+	// in us, bin(upper(b) - 1) == b
+	static uint64_t upper(size_t b) {
+		if (b < LINEAR)
+			return b + 1;
+		size_t e = 6 + (b - LINEAR) / SUB;
+		uint64_t s = (b - LINEAR) % SUB + SUB;
+		return (s + 1) << (e - 5);
+	}
+};
@@ -0,0 +1,110 @@
+// The receive path does no heap work per packet once it runs: the same
+// steps as a port reader (Serial::Read into a fixed buffer, D1Scanner,
+// Mailbox::Deliver with history and derivatives) and the cook side
+// consumer, counted by a global operator new hook on this thread.
+
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "D1Scanner.hpp"
+#include "PortRegistry.hpp"
+#include "Serial.hpp"
+#include "TestUtil.hpp"
+#include "Trace.hpp"
+
+static thread_local bool counting = false;
+static thread_local uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+	if (counting)
+		allocations++;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+// kept out of line, inlined into a caller GCC pairs the free with new and warns
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+	free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+int main() {
+	// the hook sees this thread's allocations
+	counting = true;
+	std::vector<int> probe(4);
+	CHECK(allocations == 1);
+	counting = false;
+	allocations = 0;
+
+	Pty pty;
+	Serial serial;
+	CHECK(serial.Open(pty.name, { CBR_38400, 8, ODDPARITY, ONESTOPBIT }));
+	serial.SetWaitTimeout(500);
+	serial.SetInterByteTimeout(1);
+	Trace::Instance().Enable(true);
+
+	std::unique_ptr<Mailbox> mailbox(new Mailbox());
+	mailbox->cameraid = 1;
+	mailbox->keepHistory = true;
+	mailbox->derivativeWindow = 5;
+	D1Scanner scanner;
+
+	const int WARMUP = 100;
+	const int FRAMES = 2000;
+	std::thread writer([&]() {
+		uint8_t frame[D1::FRAME];
+		const uint8_t noise[] = { D1::SYNC, 0x13 };
+		for (int k = 0; k < WARMUP + FRAMES; k++) {
+			makeFrame(frame, 1, k);
+			pty.write(frame, sizeof(frame));
+			if (k % 50 == 0)
+				pty.write(noise, sizeof(noise));
+			if (k % 25 == 0)
+				sleepMs(1);
+		}
+	});
+
+	uint8_t buffer[1024];
+	int frames = 0;
+	int reads = 0;
+	uint64_t warm = 0;
+	Sample slice;
+	while (frames < WARMUP + FRAMES) {
+		if (frames >= WARMUP && !counting) {
+			counting = true;
+			warm = allocations;
+		}
+		int n = serial.Read(buffer, sizeof(buffer));
+		CHECK(n > 0);
+		reads++;
+		int64_t now = nowNs();
+		scanner.feed(buffer, (size_t)n,
+			[](const uint8_t* p) { return D1::isValid(p); },
+			[&](const uint8_t* p, size_t) {
+				CHECK(mailbox->Deliver(p, now));
+				frames++;
+			});
+
+		// what a cook takes out
+		Camera& cam = mailbox->cameras[1];
+		if (cam.samples.update())
+			CHECK(D1::decode(cam.samples.readBuffer().frame).zoom >= 0);
+		while (mailbox->slices.pop(slice)) {
+		}
+	}
+	counting = false;
+	writer.join();
+	Trace::Instance().Enable(false);
+
+	printf("%d frames in %d reads, %llu allocations after warm-up\n",
+		frames, reads, (unsigned long long)(allocations - warm));
+	CHECK(mailbox->packets == (uint64_t)frames);
+	CHECK(allocations == warm);
+	printf("AllocTest passed\n");
+	return 0;
+}
@@ -0,0 +1,60 @@
+// decodeBatch throughput per code path against the scalar path, over a
+// take's worth of frames that fits in L2 and one that does not.
+
+#include <vector>
+
+#include "D1Batch.hpp"
+#include "TestUtil.hpp"
+
+static const char* name(D1::Isa isa) {
+	switch (isa) {
+	case D1::Isa::Avx2: return "avx2";
+	case D1::Isa::Ssse3: return "ssse3";
+	default: return "scalar";
+	}
+}
+
+// ns per frame, best of several runs
+static double run(D1::Isa isa, const std::vector<uint8_t>& data, size_t n, std::vector<double> (&store)[D1::FIELDS]) {
+	double* columns[D1::FIELDS];
+	for (size_t f = 0; f < D1::FIELDS; f++) {
+		columns[f] = store[f].data();
+	}
+	size_t repeat = (1 << 22) / n + 1;
+	double best = 1e30;
+	for (int r = 0; r < 5; r++) {
+		int64_t start = nowNs();
+		for (size_t k = 0; k < repeat; k++) {
+			D1::decodeBatch(isa, data.data(), n, D1::FRAME, columns);
+		}
+		double ns = (double)(nowNs() - start) / (double)(repeat * n);
+		if (ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+int main() {
+	for (size_t n : { (size_t)4096, (size_t)1 << 20 }) {
+		std::vector<uint8_t> data(n * D1::FRAME);
+		for (size_t i = 0; i < n; i++) {
+			makeFrame(data.data() + i * D1::FRAME, 1, (int)(i % 100000) - 50000);
+		}
+		std::vector<double> store[D1::FIELDS];
+		for (auto& s : store) {
+			s.resize(n);
+		}
+
+		double scalar = run(D1::Isa::Scalar, data, n, store);
+		printf("%zu frames:\n", n);
+		for (D1::Isa isa : { D1::Isa::Scalar, D1::Isa::Ssse3, D1::Isa::Avx2 }) {
+			if (!D1::supports(isa))
+				continue;
+			double ns = isa == D1::Isa::Scalar ? scalar : run(isa, data, n, store);
+			printf("  %-6s %6.2f ns/frame  %7.1f Mframes/s  %5.2fx scalar\n",
+				name(isa), ns, 1e3 / ns, scalar / ns);
+			CHECK(ns > 0.0);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,115 @@
+// Every decodeBatch path this CPU runs gives the scalar helpers of
+// D1Packet.hpp bit for bit, for any batch length, stride and alignment,
+// and writes nothing past the last frame.
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "D1Batch.hpp"
+#include "TestUtil.hpp"
+
+static const char* name(D1::Isa isa) {
+	switch (isa) {
+	case D1::Isa::Avx2: return "avx2";
+	case D1::Isa::Ssse3: return "ssse3";
+	default: return "scalar";
+	}
+}
+
+static double expected(const uint8_t* p, size_t f) {
+	if (f <= D1::Roll)
+		return D1::rotation(p, (D1::Field)f);
+	if (f <= D1::Height)
+		return D1::position(p, (D1::Field)f);
+	return D1::lens(p, (D1::Field)f);
+}
+
+// field values the sign extension and scaling could get wrong
+static const uint32_t EDGES[] = { 0x000000, 0x000001, 0x7fffff, 0x800000, 0x800001, 0xffffff, 0x080000, 0x07ffff };
+
+static void testPath(D1::Isa isa, std::mt19937& rng) {
+	const size_t STRIDES[] = { D1::FRAME, 32, 48, 64 };
+	const double SENTINEL = -12345.678;
+	int batches = 0;
+
+	for (size_t stride : STRIDES) {
+		for (size_t n = 0; n <= 67; n++) {
+			// odd start, so loads are unaligned
+			std::vector<uint8_t> data(1 + n * stride + 16);
+			const uint8_t* frames = data.data() + 1;
+			for (auto& b : data) {
+				b = (uint8_t)rng();
+			}
+			for (size_t i = 0; i < n; i++) {
+				uint8_t* p = data.data() + 1 + i * stride;
+				for (size_t f = 0; f < D1::FIELDS; f++) {
+					if (rng() % 4 != 0)
+						continue;
+					uint32_t v = EDGES[rng() % (sizeof(EDGES) / sizeof(EDGES[0]))];
+					p[D1::OFFSETS[f]] = (uint8_t)(v >> 16);
+					p[D1::OFFSETS[f] + 1] = (uint8_t)(v >> 8);
+					p[D1::OFFSETS[f] + 2] = (uint8_t)v;
+				}
+			}
+
+			std::vector<double> store[D1::FIELDS];
+			std::vector<double> scalarStore[D1::FIELDS];
+			double* columns[D1::FIELDS];
+			double* scalarColumns[D1::FIELDS];
+			for (size_t f = 0; f < D1::FIELDS; f++) {
+				store[f].assign(n + 8, SENTINEL);
+				scalarStore[f].assign(n + 8, SENTINEL);
+				columns[f] = store[f].data();
+				scalarColumns[f] = scalarStore[f].data();
+			}
+
+			D1::decodeBatch(isa, frames, n, stride, columns);
+			D1::decodeBatchScalar(frames, n, stride, scalarColumns);
+
+			for (size_t f = 0; f < D1::FIELDS; f++) {
+				CHECK(memcmp(store[f].data(), scalarStore[f].data(), n * sizeof(double)) == 0);
+				for (size_t i = 0; i < n; i++) {
+					double e = expected(frames + i * stride, f);
+					CHECK(memcmp(&store[f][i], &e, sizeof(double)) == 0);
+				}
+				for (size_t i = n; i < n + 8; i++) {
+					CHECK(store[f][i] == SENTINEL);
+				}
+			}
+			batches++;
+		}
+	}
+	printf("%s: %d batches bit exact\n", name(isa), batches);
+}
+
+int main() {
+	std::mt19937 rng(777);
+	CHECK(D1::supports(D1::Isa::Scalar));
+	for (D1::Isa isa : { D1::Isa::Scalar, D1::Isa::Ssse3, D1::Isa::Avx2 }) {
+		if (D1::supports(isa))
+			testPath(isa, rng);
+		else
+			printf("%s: not supported here, skipped\n", name(isa));
+	}
+
+	// the dispatching entry point agrees too
+	uint8_t frames[D1::FRAME * 9];
+	for (int i = 0; i < 9; i++) {
+		makeFrame(frames + i * D1::FRAME, 1, i * 1000 - 4000);
+	}
+	double a[D1::FIELDS][9];
+	double b[D1::FIELDS][9];
+	double* ca[D1::FIELDS];
+	double* cb[D1::FIELDS];
+	for (size_t f = 0; f < D1::FIELDS; f++) {
+		ca[f] = a[f];
+		cb[f] = b[f];
+	}
+	D1::decodeBatch(frames, 9, D1::FRAME, ca);
+	D1::decodeBatchScalar(frames, 9, D1::FRAME, cb);
+	CHECK(memcmp(a, b, sizeof(a)) == 0);
+
+	printf("D1BatchTest passed\n");
+	return 0;
+}
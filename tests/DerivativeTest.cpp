@@ -0,0 +1,92 @@
+// Velocity and acceleration from the least squares window: exact on a
+// quadratic track at uneven frame times, a plain difference from two
+// frames, and a window that starts over after a gap or a time step back.
+
+#include <cmath>
+
+#include "Derivative.hpp"
+#include "TestUtil.hpp"
+
+static const size_t V = TimedPose::VALUES;
+
+// x = 1 + 2t - 3t^2, pan 160 + 150t + 40t^2 over +180 into -180
+static D1::Pose quadratic(double t) {
+	return { 1.0 + 2.0 * t - 3.0 * t * t, 1.5, 0.5 * t, 4.0 * t * t,
+		std::remainder(160.0 + 150.0 * t + 40.0 * t * t, 360.0), -2.0, 300000, 200000 };
+}
+
+static void testQuadratic() {
+	const int64_t times[] = { 0, 17000000, 31000000, 52000000, 70000000, 83000000, 101000000, 119000000, 140000000 };
+	Differentiator d;
+	double vel[V], acc[V];
+	for (int64_t time : times) {
+		double t = time / 1e9;
+		d.add(time, quadratic(t), 7, vel, acc);
+		if (time < 31000000)
+			continue;
+		CHECK(std::fabs(vel[0] - (2.0 - 6.0 * t)) < 1e-6);
+		CHECK(std::fabs(acc[0] + 6.0) < 1e-6);
+		CHECK(std::fabs(vel[2] - 0.5) < 1e-9 && std::fabs(acc[2]) < 1e-6);
+		CHECK(std::fabs(vel[3] - 8.0 * t) < 1e-6);
+		CHECK(std::fabs(acc[3] - 8.0) < 1e-6);
+		CHECK(std::fabs(vel[4] - (150.0 + 80.0 * t)) < 1e-6);
+		CHECK(std::fabs(acc[4] - 80.0) < 1e-6);
+		CHECK(vel[1] == 0.0 && vel[6] == 0.0 && acc[7] == 0.0);
+	}
+	// the pan really crossed the wrap inside the window
+	CHECK(quadratic(0.101).ry > 170.0 && quadratic(0.140).ry < -170.0);
+}
+
+static void testTwoFrames() {
+	Differentiator d;
+	double vel[V], acc[V];
+	d.add(1000000000, quadratic(0.0), 5, vel, acc);
+	for (size_t f = 0; f < V; f++)
+		CHECK(vel[f] == 0.0 && acc[f] == 0.0);
+	d.add(1020000000, quadratic(0.02), 5, vel, acc);
+	CHECK(std::fabs(vel[0] - (quadratic(0.02).tx - 1.0) / 0.02) < 1e-9);
+	CHECK(acc[0] == 0.0 && acc[4] == 0.0);
+
+	// a window of 2 stays a difference however many frames came
+	d.add(1040000000, quadratic(0.04), 2, vel, acc);
+	CHECK(std::fabs(vel[0] - (quadratic(0.04).tx - quadratic(0.02).tx) / 0.02) < 1e-9);
+	CHECK(acc[0] == 0.0);
+}
+
+static void testGap() {
+	Differentiator d;
+	double vel[V], acc[V];
+	for (int k = 0; k < 5; k++)
+		d.add(k * 20000000LL, quadratic(k * 0.02), 5, vel, acc);
+	CHECK(vel[0] != 0.0);
+
+	// after a dropout the first frame has nothing to go on
+	int64_t t = 4 * 20000000LL + 600000000LL;
+	D1::Pose far = quadratic(5.0);
+	d.add(t, far, 5, vel, acc);
+	for (size_t f = 0; f < V; f++)
+		CHECK(vel[f] == 0.0 && acc[f] == 0.0);
+	// and the next one only differences against it, nothing from before
+	D1::Pose next = far;
+	next.tx += 0.01;
+	d.add(t + 20000000, next, 5, vel, acc);
+	CHECK(std::fabs(vel[0] - 0.5) < 1e-9 && acc[0] == 0.0);
+
+	// a frame from before the newest starts over as well
+	d.add(t, far, 5, vel, acc);
+	CHECK(vel[0] == 0.0);
+
+	// a shorter gap keeps the window
+	d.reset();
+	d.add(0, quadratic(0.0), 5, vel, acc);
+	d.add(400000000, quadratic(0.4), 5, vel, acc);
+	CHECK(std::fabs(vel[0] - (quadratic(0.4).tx - 1.0) / 0.4) < 1e-9);
+}
+
+int main() {
+	testQuadratic();
+	testTwoFrames();
+	testGap();
+	printf("DerivativeTest passed\n");
+	return 0;
+}
@@ -0,0 +1,178 @@
+// USB adapter latency timer handling against a fake sysfs tree: the value
+// is read back on Open, lowered when asked before or after Open, found
+// through a /dev/serial/by-id style link, and -1 without a timer.
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "Logger.hpp"
+#include "PortRegistry.hpp"
+#include "Serial.hpp"
+#include "TestUtil.hpp"
+
+namespace fs = std::filesystem;
+
+static const Serial::SerialConfig CONFIG = { CBR_38400, 8, ODDPARITY, ONESTOPBIT };
+
+// latency_timer of the ttyUSBn behind the pty, as ftdi_sio lays it out
+static fs::path timerFile(const fs::path& root, const Pty& pty) {
+	return root / "bus/usb-serial/devices" / fs::path(pty.name).filename() / "latency_timer";
+}
+
+static void writeTimer(const fs::path& file, int ms) {
+	fs::create_directories(file.parent_path());
+	std::ofstream(file) << ms << "\n";
+}
+
+static int readTimer(const fs::path& file) {
+	int ms = -1;
+	std::ifstream(file) >> ms;
+	return ms;
+}
+
+static bool waitConnected(SharedPort& port) {
+	int64_t end = nowNs() + 3000000000LL;
+	while (port.GetState() != SharedPort::Connected) {
+		if (nowNs() > end)
+			return false;
+		sleepMs(1);
+	}
+	return true;
+}
+
+// a subscriber's request is applied by the monitor, which reopens a
+// connected port for it without counting a reconnect
+static void testRegistry() {
+	std::string log = "/tmp/shotoku-latency-" + std::to_string(getpid()) + ".log";
+	Logger::Instance().SetFile(log, 1 << 20, 0);
+
+	Pty pty;
+	std::unique_ptr<Mailbox> mailbox(new Mailbox());
+	mailbox->cameraid = 1;
+	std::shared_ptr<SharedPort> port = PortRegistry::Instance().Subscribe(pty.name, mailbox.get(), false);
+	CHECK(waitConnected(*port));
+
+	Command latency = { Command::LatencyTimer, { 1.0 } };
+	CHECK(mailbox->commands.push(latency));
+	// no timer on a pty, so only the reopen can be seen
+	int64_t end = nowNs() + 3000000000LL;
+	uint64_t wakeups = port->Wakeups();
+	while (mailbox->commands.size() != 0) {
+		CHECK(nowNs() < end);
+		sleepMs(5);
+	}
+	sleepMs(200);
+	CHECK(waitConnected(*port));
+	CHECK(port->Reconnects() == 0);
+	CHECK(port->LatencyTimer() == -1);
+
+	uint8_t frame[D1::FRAME];
+	makeFrame(frame, 1, 0);
+	pty.write(frame, sizeof(frame));
+	end = nowNs() + 2000000000LL;
+	while (mailbox->packets != 1) {
+		CHECK(nowNs() < end);
+		sleepMs(2);
+	}
+	CHECK(port->Wakeups() > wakeups);
+
+	PortRegistry::Instance().Unsubscribe(port, mailbox.get());
+
+	// opened twice, nothing lost
+	end = nowNs() + 2000000000LL;
+	while (Logger::Instance().Written() < 2) {
+		CHECK(nowNs() < end);
+		sleepMs(5);
+	}
+	Logger::Instance().SetFile("");
+	std::stringstream text;
+	text << std::ifstream(log).rdbuf();
+	remove(log.c_str());
+	std::string lines = text.str();
+	size_t opened = 0;
+	for (size_t at = lines.find(" opened"); at != std::string::npos; at = lines.find(" opened", at + 1)) {
+		opened++;
+	}
+	CHECK(opened == 2);
+	CHECK(lines.find(" lost") == std::string::npos);
+}
+
+int main() {
+	char tmpl[] = "/tmp/shotoku-sysfs-XXXXXX";
+	CHECK(mkdtemp(tmpl) != nullptr);
+	fs::path root = tmpl;
+
+	Pty pty;
+	fs::path file = timerFile(root, pty);
+	writeTimer(file, 16);
+
+	// 0 leaves the driver setting alone and reports it
+	{
+		Serial serial;
+		serial.SetSysfsRoot(root.string());
+		CHECK(serial.Open(pty.name, CONFIG));
+		CHECK(serial.LatencyTimer() == 16);
+		CHECK(readTimer(file) == 16);
+
+		// lowered at once on an open port
+		serial.SetLatencyTimer(1);
+		CHECK(serial.LatencyTimer() == 1);
+		CHECK(readTimer(file) == 1);
+	}
+
+	// or when the port opens
+	writeTimer(file, 16);
+	{
+		Serial serial;
+		serial.SetSysfsRoot(root.string());
+		serial.SetLatencyTimer(2);
+		CHECK(serial.LatencyTimer() == -1);
+		CHECK(serial.Open(pty.name, CONFIG));
+		CHECK(serial.LatencyTimer() == 2);
+		CHECK(readTimer(file) == 2);
+	}
+
+	// a by-id link resolves to the tty the driver knows
+	writeTimer(file, 16);
+	{
+		fs::path link = root / "by-id" / "usb-FTDI_USB-RS422_Cable_FT0TEST-if00-port0";
+		fs::create_directories(link.parent_path());
+		fs::create_symlink(pty.name, link);
+
+		Serial serial;
+		serial.SetSysfsRoot(root.string());
+		serial.SetLatencyTimer(4);
+		CHECK(serial.Open(link.string(), CONFIG));
+		CHECK(serial.LatencyTimer() == 4);
+		CHECK(readTimer(file) == 4);
+	}
+
+	// a port without the file has no timer, and nothing is created
+	{
+		Pty other;
+		Serial serial;
+		serial.SetSysfsRoot(root.string());
+		serial.SetLatencyTimer(1);
+		CHECK(serial.Open(other.name, CONFIG));
+		CHECK(serial.LatencyTimer() == -1);
+		CHECK(!fs::exists(timerFile(root, other)));
+	}
+
+	// an unreadable value counts as none
+	std::ofstream(file) << "garbage\n";
+	{
+		Serial serial;
+		serial.SetSysfsRoot(root.string());
+		CHECK(serial.Open(pty.name, CONFIG));
+		CHECK(serial.LatencyTimer() == -1);
+	}
+
+	fs::remove_all(root);
+	testRegistry();
+	printf("LatencyTimerTest passed\n");
+	return 0;
+}
@@ -0,0 +1,98 @@
+// Cost of a Logger call on the caller's thread: with logging off, with the
+// record queued, and with the ring full so it is dropped, from one thread
+// and from four at once. Every call ends up either written or counted as
+// dropped.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Logger.hpp"
+#include "TestUtil.hpp"
+
+static const char* PORT = "/dev/serial/by-id/usb-FTDI_USB-RS422_Cable_FT0TEST-if00-port0";
+
+static bool drained(Logger& logger, uint64_t calls) {
+	int64_t end = nowNs() + 5000000000LL;
+	while (logger.Written() + logger.Dropped() < calls) {
+		if (nowNs() > end)
+			return false;
+		sleepMs(5);
+	}
+	return logger.Written() + logger.Dropped() == calls;
+}
+
+// ns per call of n calls, the time already taken by the caller
+static double timeCalls(Logger& logger, int n, bool at) {
+	int64_t start = nowNs();
+	for (int i = 0; i < n; i++) {
+		if (at)
+			logger.LogAt(start, Logger::Warning, Logger::FrameGap, PORT, i);
+		else
+			logger.Log(Logger::Warning, Logger::Resync, PORT, i);
+	}
+	return (double)(nowNs() - start) / n;
+}
+
+int main() {
+	std::string path = "/tmp/shotoku-logger-bench-" + std::to_string(getpid()) + ".log";
+	Logger logger;
+
+	double off = timeCalls(logger, 1000000, false);
+	printf("logging off:           %6.1f ns/call\n", off);
+
+	logger.SetFile(path, 64 << 20, 0);
+	uint64_t calls = 0;
+
+	// bursts the writer keeps up with, every record is queued
+	double queued = 1e30;
+	double queuedAt = 1e30;
+	for (int r = 0; r < 20; r++) {
+		uint64_t dropped = logger.Dropped();
+		double ns = timeCalls(logger, 500, r % 2 != 0);
+		calls += 500;
+		CHECK(drained(logger, calls));
+		if (logger.Dropped() != dropped)
+			continue;
+		if (r % 2)
+			queuedAt = std::min(queuedAt, ns);
+		else
+			queued = std::min(queued, ns);
+	}
+	printf("queued, Log:           %6.1f ns/call\n", queued);
+	printf("queued, LogAt:         %6.1f ns/call\n", queuedAt);
+
+	// far more than the ring holds, most of these are dropped
+	double full = timeCalls(logger, 1000000, true);
+	calls += 1000000;
+	printf("ring full:             %6.1f ns/call, %llu dropped\n", full, (unsigned long long)logger.Dropped());
+	CHECK(logger.Dropped() > 0);
+	CHECK(drained(logger, calls));
+
+	// four threads at once
+	const int THREADS = 4;
+	const int PER = 250000;
+	std::vector<std::thread> threads;
+	int64_t start = nowNs();
+	for (int t = 0; t < THREADS; t++) {
+		threads.emplace_back([&]() { timeCalls(logger, PER, true); });
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	double contended = (double)(nowNs() - start) / (THREADS * PER);
+	calls += THREADS * PER;
+	printf("%d threads:             %6.1f ns/call\n", THREADS, contended);
+	CHECK(drained(logger, calls));
+	printf("%llu written, %llu dropped\n", (unsigned long long)logger.Written(), (unsigned long long)logger.Dropped());
+
+	logger.SetFile("");
+	remove(path.c_str());
+
+	// generous, this is about catching a lock or a syscall on the hot path
+	CHECK(off < 100.0);
+	CHECK(queued < 1000.0 && queuedAt < 1000.0);
+	CHECK(full < 1000.0);
+	return 0;
+}
@@ -0,0 +1,132 @@
+// Delayed pose sampling: clamping to the history, Hermite and linear
+// curves on tracks they reproduce exactly, the slerped rotation, and
+// angles that keep the winding of the packets across +-180 so switching
+// the delay on does not move the output by a turn.
+
+#include <cmath>
+
+#include "PoseHistory.hpp"
+#include "TestUtil.hpp"
+
+static const int64_t DT = 20000000;	// ns between frames
+
+static D1::Pose pose(double tx, double rx, double ry, double rz) {
+	return { tx, 1.5, 0.0, rx, ry, rz, 300000, 200000 };
+}
+
+static void testClamp() {
+	PoseHistory history;
+	TimedPose out;
+	CHECK(!history.sample(0, true, out));
+
+	for (int k = 0; k < 5; k++)
+		history.push((k + 1) * DT, pose(k, 0.0, 10.0 * k, 0.0));
+	// before the first, at an entry and after the last entry
+	CHECK(history.sample(0, true, out));
+	CHECK(out.time == 0 && out.v[0] == 0.0 && out.v[4] == 0.0);
+	CHECK(history.sample(3 * DT, true, out));
+	CHECK(out.v[0] == 2.0 && out.v[4] == 20.0);
+	CHECK(history.sample(100 * DT, false, out));
+	CHECK(out.time == 100 * DT && out.v[0] == 4.0 && out.v[4] == 40.0);
+}
+
+static void testCurves() {
+	// x = t^2 at even spacing: the central difference tangents are exact,
+	// so the cubic through them is the parabola itself
+	PoseHistory history;
+	for (int k = 0; k < 10; k++) {
+		double t = k * DT / 1e9;
+		history.push(k * DT, pose(t * t, 0.0, 0.0, 0.0));
+	}
+	TimedPose out;
+	for (int64_t t = 2 * DT; t < 7 * DT; t += DT / 7) {
+		CHECK(history.sample(t, true, out));
+		double s = t / 1e9;
+		CHECK(std::fabs(out.v[0] - s * s) < 1e-12);
+		// and the line between frames by the linear curve
+		CHECK(history.sample(t, false, out));
+		int64_t a = t / DT * DT;
+		double sa = a / 1e9, sb = (a + DT) / 1e9;
+		CHECK(std::fabs(out.v[0] - (sa * sa + (sb * sb - sa * sa) * (t - a) / DT)) < 1e-12);
+	}
+
+	// a straight line at uneven spacing, one-sided tangents at the ends
+	history.clear();
+	int64_t times[] = { 0, 15000000, 40000000, 50000000, 80000000 };
+	for (int64_t t : times)
+		history.push(t, pose(2.0 * t / 1e9, 0.0, 0.0, 0.0));
+	for (int64_t t = 0; t <= 80000000; t += 3000000) {
+		CHECK(history.sample(t, true, out));
+		CHECK(std::fabs(out.v[0] - 2.0 * t / 1e9) < 1e-12);
+	}
+}
+
+static void testSlerp() {
+	// one axis at a time turns at a constant rate
+	PoseHistory history;
+	history.push(0, pose(0.0, 0.0, 10.0, 0.0));
+	history.push(DT, pose(0.0, 0.0, 30.0, 0.0));
+	TimedPose out;
+	CHECK(history.sample(DT / 2, true, out));
+	CHECK(std::fabs(out.v[4] - 20.0) < 1e-9);
+	CHECK(std::fabs(out.v[3]) < 1e-9 && std::fabs(out.v[5]) < 1e-9);
+	CHECK(history.sample(DT / 4, true, out));
+	CHECK(std::fabs(out.v[4] - 15.0) < 1e-9);
+
+	// over the top: the head tilted past 90 stays that way round
+	history.clear();
+	history.push(0, pose(0.0, 95.0, 30.0, 5.0));
+	history.push(DT, pose(0.0, 105.0, 30.0, 5.0));
+	CHECK(history.sample(DT / 2, true, out));
+	CHECK(std::fabs(out.v[3] - 100.0) < 1e-9);
+	CHECK(std::fabs(out.v[4] - 30.0) < 1e-9);
+	CHECK(std::fabs(out.v[5] - 5.0) < 1e-9);
+}
+
+// pan at 120 deg/s from 150 deg, tilted and rolled a little
+static double pan(int64_t t) {
+	return 150.0 + 120.0 * t / 1e9;
+}
+
+static void testWrap() {
+	// a head reporting pan past 180, as the packets can: 150 to 246 deg
+	PoseHistory history;
+	for (int k = 0; k < 41; k++)
+		history.push(k * DT, pose(0.0, -3.0, pan(k * DT), 1.0));
+	CHECK(history.back().v[4] > 240.0);
+
+	// the delayed output follows the packets, no turn where the
+	// quaternion's own angles wrap; steps this small are normalized lerps,
+	// a few 1e-6 deg off the constant rate
+	TimedPose out;
+	double last = 0.0;
+	for (int64_t t = 0; t <= 40 * DT; t += 1000000) {
+		CHECK(history.sample(t, true, out));
+		CHECK(std::fabs(out.v[4] - pan(t)) < 1e-4);
+		CHECK(std::fabs(out.v[3] + 3.0) < 1e-4 && std::fabs(out.v[5] - 1.0) < 1e-4);
+		if (t > 0)
+			CHECK(std::fabs(out.v[4] - last) < 0.2);
+		last = out.v[4];
+	}
+
+	// a head wrapping its pan at +-180 itself: between frames the output
+	// goes the short way on from the earlier one and lands on the later
+	history.clear();
+	history.push(0, pose(0.0, 0.0, 176.0, 0.0));
+	history.push(DT, pose(0.0, 0.0, -176.0, 0.0));
+	CHECK(history.sample(DT / 4, true, out));
+	CHECK(std::fabs(out.v[4] - 178.0) < 1e-9);
+	CHECK(history.sample(3 * DT / 4, true, out));
+	CHECK(std::fabs(angleDelta(182.0, out.v[4])) < 1e-9);
+	CHECK(history.sample(DT, true, out));
+	CHECK(out.v[4] == -176.0);
+}
+
+int main() {
+	testClamp();
+	testCurves();
+	testSlerp();
+	testWrap();
+	printf("PoseHistoryTest passed\n");
+	return 0;
+}
@@ -0,0 +1,186 @@
+// Pose prediction against synthetic tracks at 50 Hz: each model
+// extrapolates a track of its own order exactly, predictions stay right
+// across the +-180 pan wrap, and the scored error matches the error the
+// model is known to make.
+
+#include <cmath>
+
+#include "Predictor.hpp"
+#include "TestUtil.hpp"
+
+static const int64_t DT = 20000000;	// ns between frames
+
+typedef void (*Track)(double t, D1::Pose& p);
+
+// pan at 30 deg/s, dolly at 0.5 m/s
+static void linear(double t, D1::Pose& p) {
+	p = { 0.5 * t, 1.5, -0.25 * t, -5.0, 10.0 + 30.0 * t, 0.0, 300000, 200000 };
+}
+
+// zoom and dolly speeding up, 40000 units/s^2 and 2 m/s^2
+static void accelerating(double t, D1::Pose& p) {
+	p = { t * t, 1.5, 0.0, 0.0, 20.0, 0.0, (int32_t)std::lround(100000.0 + 20000.0 * t * t), 200000 };
+}
+
+// pan at 120 deg/s, over +180 into -180 between frames 14 and 15
+static void wrapping(double t, D1::Pose& p) {
+	p = { 0.0, 1.5, 0.0, 2.0, std::remainder(145.2 + 120.0 * t, 360.0), 0.0, 300000, 200000 };
+}
+
+static void fill(PoseHistory& history, Track track, int frames) {
+	for (int k = 0; k < frames; k++) {
+		D1::Pose p;
+		track(k * DT / 1e9, p);
+		history.push(k * DT, p);
+	}
+}
+
+// largest difference to the track at the target, angles the short way
+static double error(Track track, const TimedPose& out, size_t from, size_t to) {
+	D1::Pose p;
+	track(out.time / 1e9, p);
+	double real[TimedPose::VALUES] = { p.tx, p.ty, p.tz, p.rx, p.ry, p.rz, (double)p.zoom, (double)p.focus };
+	double e = 0.0;
+	for (size_t i = from; i < to; i++) {
+		double d = TimedPose::isAngle(i) ? angleDelta(real[i], out.v[i]) : out.v[i] - real[i];
+		e = std::max(e, std::fabs(d));
+	}
+	return e;
+}
+
+static void testExact() {
+	PoseHistory history;
+	Predictor predictor;
+	TimedPose out;
+
+	// not enough frames yet
+	fill(history, linear, 1);
+	CHECK(!predictor.predict(history, Predictor::ConstantVelocity, DT, out));
+	fill(history, linear, 2);
+	CHECK(!predictor.predict(history, Predictor::ConstantAcceleration, 2 * DT, out));
+	CHECK(!predictor.predict(history, Predictor::Kalman, 2 * DT, out));
+	CHECK(!predictor.predict(history, Predictor::Off, 2 * DT, out));
+
+	// a constant velocity pan, 50 ms ahead, by both polynomial models
+	history.clear();
+	fill(history, linear, 10);
+	int64_t target = history.back().time + 50000000;
+	CHECK(predictor.predict(history, Predictor::ConstantVelocity, target, out));
+	CHECK(out.time == target);
+	CHECK(error(linear, out, 0, 8) < 1e-9);
+	CHECK(predictor.predict(history, Predictor::ConstantAcceleration, target, out));
+	CHECK(error(linear, out, 0, 8) < 1e-9);
+
+	// a constant acceleration zoom only by the quadratic model, the linear
+	// one lags by a * lead * (lead + dt) / 2
+	history.clear();
+	fill(history, accelerating, 10);
+	target = history.back().time + 60000000;
+	CHECK(predictor.predict(history, Predictor::ConstantAcceleration, target, out));
+	// the zoom is rounded to whole units on the way in
+	CHECK(error(accelerating, out, 6, 7) < 2.0);
+	CHECK(error(accelerating, out, 0, 3) < 1e-9);
+	CHECK(predictor.predict(history, Predictor::ConstantVelocity, target, out));
+	CHECK(std::fabs(error(accelerating, out, 6, 7) - 40000.0 * 0.06 * 0.08 / 2) < 2.0);
+}
+
+static void testWrap() {
+	// the last two frames straddle +-180, the prediction carries on from -180
+	PoseHistory history;
+	fill(history, wrapping, 16);
+	CHECK(history[14].v[4] > 170.0 && history[15].v[4] < -170.0);
+	int64_t target = history.back().time + 40000000;
+
+	Predictor predictor;
+	TimedPose out;
+	CHECK(predictor.predict(history, Predictor::ConstantVelocity, target, out));
+	CHECK(error(wrapping, out, 3, 6) < 1e-9);
+	CHECK(out.v[4] >= -180.0 && out.v[4] <= 180.0);
+	CHECK(predictor.predict(history, Predictor::ConstantAcceleration, target, out));
+	CHECK(error(wrapping, out, 3, 6) < 1e-9);
+	CHECK(out.v[4] >= -180.0 && out.v[4] <= 180.0);
+
+	// the filter runs frame by frame from a long run up, its estimate
+	// settles on the true rate
+	Predictor kalman;
+	PoseHistory run;
+	for (int k = 0; k < 100; k++) {
+		D1::Pose p;
+		wrapping((k - 84) * DT / 1e9, p);
+		run.push(k * DT, p);
+		kalman.update(run, 1.0);
+	}
+	CHECK(run[98].v[4] > 170.0 && run[99].v[4] < -170.0);
+	CHECK(kalman.predict(run, Predictor::Kalman, run.back().time + 40000000, out));
+	D1::Pose p;
+	wrapping((99 - 84) * DT / 1e9 + 0.04, p);
+	CHECK(std::fabs(angleDelta(p.ry, out.v[4])) < 0.05);
+	CHECK(out.v[4] >= -180.0 && out.v[4] <= 180.0);
+}
+
+static void testKalman() {
+	// on a constant velocity track the filter ends up where the track goes
+	Predictor predictor;
+	PoseHistory history;
+	for (int k = 0; k < 150; k++) {
+		D1::Pose p;
+		linear(k * DT / 1e9, p);
+		history.push(k * DT, p);
+		predictor.update(history, 1.0);
+	}
+	TimedPose out;
+	CHECK(predictor.predict(history, Predictor::Kalman, history.back().time + 50000000, out));
+	CHECK(error(linear, out, 0, 3) < 1e-3);
+	CHECK(error(linear, out, 3, 6) < 0.05);
+	CHECK(error(linear, out, 6, 8) < 1.0);
+}
+
+// predictions are scored once the track reaches their target
+static void testScore() {
+	const int LEAD = 3;	// frames, so the target is a real frame
+	Predictor predictor;
+	PoseHistory history;
+	TimedPose out;
+	int predicted = 0;
+	for (int k = 0; k < 40; k++) {
+		D1::Pose p;
+		accelerating(k * DT / 1e9, p);
+		history.push(k * DT, p);
+		predictor.update(history, 1.0);
+		if (predictor.predict(history, Predictor::ConstantVelocity, (k + LEAD) * DT, out))
+			predicted++;
+		// nothing resolved before the first target comes round
+		if (k < 1 + LEAD)
+			CHECK(predictor.errorMm() == 0.0);
+	}
+	CHECK(predicted == 39);
+
+	// the dolly lags by a * L * (L + dt) / 2 with a = 2 m/s^2, L = 60 ms
+	double lag = 2.0 * 0.06 * 0.08 / 2 * 1000.0;
+	CHECK(std::fabs(predictor.errorMm() - lag) < 1e-6);
+	CHECK(std::fabs(predictor.rmsMm() - lag) < 1e-6);
+	CHECK(predictor.errorDeg() < 1e-9);
+
+	// the linear track is predicted spot on
+	predictor.reset();
+	CHECK(predictor.rmsMm() == 0.0);
+	history.clear();
+	for (int k = 0; k < 40; k++) {
+		D1::Pose p;
+		linear(k * DT / 1e9, p);
+		history.push(k * DT, p);
+		predictor.update(history, 1.0);
+		predictor.predict(history, Predictor::ConstantAcceleration, (k + LEAD) * DT, out);
+	}
+	CHECK(predictor.rmsMm() < 1e-6);
+	CHECK(predictor.rmsDeg() < 1e-9);
+}
+
+int main() {
+	testExact();
+	testWrap();
+	testKalman();
+	testScore();
+	printf("PredictorTest passed\n");
+	return 0;
+}
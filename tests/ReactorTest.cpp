@@ -0,0 +1,134 @@
+// Reactor mode: many pty ports driven at tracker rate are all serviced by
+// the one reactor thread, every frame reaches its node, and each port
+// reports its own wakeups. A port that hangs up gets reconnected.
+
+#include <cstring>
+#include <dirent.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "PortRegistry.hpp"
+#include "TestUtil.hpp"
+
+static int threadCount() {
+	int n = 0;
+	DIR* d = opendir("/proc/self/task");
+	CHECK(d != nullptr);
+	while (dirent* e = readdir(d)) {
+		if (e->d_name[0] != '.')
+			n++;
+	}
+	closedir(d);
+	return n;
+}
+
+static bool waitFor(int ms, const std::function<bool()>& done) {
+	int64_t end = nowNs() + ms * 1000000LL;
+	while (!done()) {
+		if (nowNs() > end)
+			return false;
+		sleepMs(2);
+	}
+	return true;
+}
+
+struct Node {
+	std::unique_ptr<Mailbox> mailbox{ new Mailbox() };
+	std::shared_ptr<SharedPort> port;
+};
+
+static void testManyPorts() {
+	const int PORTS = 12;
+	const int FRAMES = 120;
+
+	std::vector<std::unique_ptr<Pty>> ptys;
+	std::vector<Node> nodes(PORTS);
+	int before = threadCount();
+
+	for (int i = 0; i < PORTS; i++) {
+		ptys.emplace_back(new Pty());
+		nodes[i].mailbox->cameraid = i + 1;
+		nodes[i].port = PortRegistry::Instance().Subscribe(ptys[i]->name, nodes[i].mailbox.get(), true);
+		CHECK(nodes[i].port->UsesReactor());
+	}
+	CHECK(waitFor(3000, [&]() {
+		for (auto& n : nodes) {
+			if (n.port->GetState() != SharedPort::Connected)
+				return false;
+		}
+		return true;
+	}));
+
+	// the monitor and the reactor, not a thread per port
+	int threads = threadCount() - before;
+	printf("%d ports on %d extra threads\n", PORTS, threads);
+	CHECK(threads <= 2);
+
+	// every port at 60 Hz
+	std::thread writer([&]() {
+		uint8_t frame[D1::FRAME];
+		for (int k = 0; k < FRAMES; k++) {
+			for (int i = 0; i < PORTS; i++) {
+				makeFrame(frame, i + 1, k);
+				ptys[i]->write(frame, sizeof(frame));
+			}
+			sleepMs(16);
+		}
+	});
+	writer.join();
+
+	CHECK(waitFor(2000, [&]() {
+		for (auto& n : nodes) {
+			if (n.mailbox->packets != (uint64_t)FRAMES)
+				return false;
+		}
+		return true;
+	}));
+
+	for (int i = 0; i < PORTS; i++) {
+		Node& n = nodes[i];
+		CHECK(n.port->framesAccepted == (uint64_t)FRAMES);
+		CHECK(n.port->checksumErrors == 0);
+		CHECK(n.port->Wakeups() > 0 && n.port->Wakeups() <= (unsigned long long)FRAMES);
+
+		Camera& cam = n.mailbox->cameras[i + 1];
+		CHECK(cam.samples.update());
+		uint8_t last[D1::FRAME];
+		makeFrame(last, i + 1, FRAMES - 1);
+		CHECK(memcmp(cam.samples.readBuffer().frame, last, D1::FRAME) == 0);
+	}
+
+	for (auto& n : nodes) {
+		PortRegistry::Instance().Unsubscribe(n.port, n.mailbox.get());
+	}
+}
+
+// without a silence timeout only the hangup itself can tell the monitor
+static void testHangup() {
+	Pty pty;
+	Node n;
+	n.mailbox->cameraid = 1;
+	Command off = { Command::SilenceTimeout, { 0.0, 0.0, 0.0 } };
+	CHECK(n.mailbox->commands.push(off));
+	n.port = PortRegistry::Instance().Subscribe(pty.name, n.mailbox.get(), true);
+	CHECK(waitFor(3000, [&]() { return n.port->GetState() == SharedPort::Connected; }));
+
+	uint8_t frame[D1::FRAME];
+	makeFrame(frame, 1, 0);
+	pty.write(frame, sizeof(frame));
+	CHECK(waitFor(2000, [&]() { return n.mailbox->packets == 1; }));
+
+	pty.closeMaster();
+	CHECK(waitFor(2000, [&]() { return n.port->GetState() == SharedPort::Waiting; }));
+	CHECK(n.port->readErrors >= 1);
+
+	PortRegistry::Instance().Unsubscribe(n.port, n.mailbox.get());
+}
+
+int main() {
+	testManyPorts();
+	testHangup();
+	printf("ReactorTest passed\n");
+	return 0;
+}
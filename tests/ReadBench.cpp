@@ -0,0 +1,131 @@
+// Wakeups and CPU time per packet of the receive loop, before and after
+// the event-driven read: the old loop (queue size or a blocking 1-byte
+// read, a new[] per call), the same loop against a driver that returns at
+// once (the full core the request was about), and Serial::Read with and
+// without an inter-byte timeout. Frames arrive at 60 Hz, paced byte by
+// byte at 38400 8O1 like a real line.
+
+#include <atomic>
+#include <fcntl.h>
+#include <functional>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <vector>
+
+#include "Serial.hpp"
+#include "TestUtil.hpp"
+
+static const int FRAMES = 120;
+static const long BYTE_NS = 286458;	// 11 bits at 38400
+
+struct Usage {
+	double wakeups;	// voluntary context switches per packet
+	double cpuUs;	// user + system per packet
+};
+
+static double cpuUs(const rusage& r) {
+	return r.ru_utime.tv_sec * 1e6 + r.ru_utime.tv_usec + r.ru_stime.tv_sec * 1e6 + r.ru_stime.tv_usec;
+}
+
+// the reader runs on its own thread, measured with RUSAGE_THREAD from the inside
+static Usage run(Pty& pty, const std::function<void(std::atomic<bool>&)>& reader) {
+	std::atomic<bool> running{ true };
+	Usage usage = {};
+	std::thread t([&]() {
+		rusage a, b;
+		getrusage(RUSAGE_THREAD, &a);
+		reader(running);
+		getrusage(RUSAGE_THREAD, &b);
+		usage.wakeups = (double)(b.ru_nvcsw - a.ru_nvcsw) / FRAMES;
+		usage.cpuUs = (cpuUs(b) - cpuUs(a)) / FRAMES;
+	});
+
+	uint8_t frame[D1::FRAME];
+	int64_t next = nowNs();
+	for (int k = 0; k < FRAMES; k++) {
+		makeFrame(frame, 1, k);
+		for (size_t i = 0; i < D1::FRAME; i++) {
+			pty.write(frame + i, 1);
+			timespec ts = { 0, BYTE_NS };
+			nanosleep(&ts, nullptr);
+		}
+		next += 16666667;
+		int64_t wait = next - nowNs();
+		if (wait > 0) {
+			timespec ts = { 0, (long)wait };
+			nanosleep(&ts, nullptr);
+		}
+	}
+	sleepMs(50);
+	running = false;
+	t.join();
+	return usage;
+}
+
+// the receive loop as it was: size the read from the queue, else block
+// for one byte; blocking = false is a driver left with timeouts that
+// return at once
+static void oldLoop(const std::string& name, bool blocking, std::atomic<bool>& running, size_t& total) {
+	int fd = open(name.c_str(), O_RDWR | O_NOCTTY);
+	CHECK(fd >= 0);
+	termios tio;
+	tcgetattr(fd, &tio);
+	cfmakeraw(&tio);
+	// a blocking read waits up to 100 ms for its byte, so the loop can stop
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = blocking ? 1 : 0;
+	tcsetattr(fd, TCSANOW, &tio);
+	while (running) {
+		int n = 0;
+		ioctl(fd, FIONREAD, &n);
+		if (n == 0)
+			n = 1;
+		unsigned char* data = new unsigned char[n];
+		ssize_t r = read(fd, data, n);
+		if (r > 0)
+			total += r;
+		delete[] data;
+	}
+	close(fd);
+}
+
+static void newLoop(const std::string& name, unsigned long interByte, std::atomic<bool>& running, size_t& total) {
+	Serial serial;
+	CHECK(serial.Open(name, { CBR_38400, 8, ODDPARITY, ONESTOPBIT }));
+	serial.SetInterByteTimeout(interByte);
+	uint8_t buf[1024];
+	while (running) {
+		int n = serial.Read(buf, sizeof(buf));
+		if (n > 0)
+			total += n;
+	}
+}
+
+int main() {
+	struct Mode {
+		const char* name;
+		std::function<void(const std::string&, std::atomic<bool>&, size_t&)> loop;
+	};
+	Mode modes[] = {
+		{ "old, blocking 1-byte read", [](const std::string& n, std::atomic<bool>& r, size_t& t) { oldLoop(n, true, r, t); } },
+		{ "old, driver returns at once", [](const std::string& n, std::atomic<bool>& r, size_t& t) { oldLoop(n, false, r, t); } },
+		{ "Read, inter-byte 0 ms", [](const std::string& n, std::atomic<bool>& r, size_t& t) { newLoop(n, 0, r, t); } },
+		{ "Read, inter-byte 2 ms", [](const std::string& n, std::atomic<bool>& r, size_t& t) { newLoop(n, 2, r, t); } },
+	};
+
+	Usage usage[4];
+	for (int m = 0; m < 4; m++) {
+		Pty pty;
+		size_t total = 0;
+		usage[m] = run(pty, [&](std::atomic<bool>& running) { modes[m].loop(pty.name, running, total); });
+		printf("%-28s %6.1f wakeups/packet %8.1f us CPU/packet\n", modes[m].name, usage[m].wakeups, usage[m].cpuUs);
+		CHECK(total == FRAMES * D1::FRAME);
+	}
+
+	// the spin is what burnt a core, the inter-byte timeout collects a
+	// frame in a wakeup or two instead of one per byte
+	CHECK(usage[1].cpuUs > 10 * usage[3].cpuUs);
+	CHECK(usage[3].wakeups * 4 < usage[0].wakeups);
+	return 0;
+}
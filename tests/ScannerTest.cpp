@@ -0,0 +1,174 @@
+// D1Scanner finds the same frames, at the same stream offsets and with the
+// same counters, however the stream is cut into read chunks, and matches
+// a byte-at-a-time reference scan. Validation stays linear on a stream of
+// nothing but sync bytes.
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "D1Scanner.hpp"
+#include "TestUtil.hpp"
+
+struct Found {
+	size_t end;	// stream offset just past the frame
+	uint8_t frame[D1::FRAME];
+};
+
+struct Result {
+	std::vector<Found> frames;
+	uint64_t resyncs = 0;
+	uint64_t rejected = 0;
+	uint64_t discarded = 0;
+	uint64_t validations = 0;
+};
+
+static bool same(const Result& a, const Result& b) {
+	if (a.frames.size() != b.frames.size() || a.resyncs != b.resyncs ||
+		a.rejected != b.rejected || a.discarded != b.discarded)
+		return false;
+	for (size_t i = 0; i < a.frames.size(); i++) {
+		if (a.frames[i].end != b.frames[i].end || memcmp(a.frames[i].frame, b.frames[i].frame, D1::FRAME) != 0)
+			return false;
+	}
+	return true;
+}
+
+// chunks of the given sizes, the last one takes the rest
+static Result scan(const std::vector<uint8_t>& stream, const std::vector<size_t>& sizes) {
+	Result r;
+	D1Scanner scanner;
+	size_t start = 0;
+	for (size_t i = 0; i <= sizes.size() && start <= stream.size(); i++) {
+		size_t n = i < sizes.size() ? std::min(sizes[i], stream.size() - start) : stream.size() - start;
+		scanner.feed(stream.data() + start, n,
+			[&](const uint8_t* p) { r.validations++; return D1::isValid(p); },
+			[&](const uint8_t* p, size_t end) {
+				Found f;
+				f.end = start + end;
+				memcpy(f.frame, p, D1::FRAME);
+				r.frames.push_back(f);
+			});
+		start += n;
+		if (i == sizes.size())
+			break;
+	}
+	r.resyncs = scanner.resyncs;
+	r.rejected = scanner.rejected;
+	r.discarded = scanner.discarded;
+	return r;
+}
+
+// what the scanner should do, one byte at a time; an unfinished candidate
+// at the end is neither a frame nor discarded yet
+static Result reference(const std::vector<uint8_t>& s) {
+	Result r;
+	bool synced = false;
+	size_t pos = 0;
+	while (pos < s.size()) {
+		if (s[pos] != D1::SYNC) {
+			r.discarded++;
+			pos++;
+			continue;
+		}
+		if (s.size() - pos < D1::FRAME)
+			break;
+		if (D1::isValid(&s[pos])) {
+			Found f;
+			f.end = pos + D1::FRAME;
+			memcpy(f.frame, &s[pos], D1::FRAME);
+			r.frames.push_back(f);
+			synced = true;
+			pos += D1::FRAME;
+			continue;
+		}
+		if (synced)
+			r.resyncs++;
+		synced = false;
+		r.rejected++;
+		r.discarded++;
+		pos++;
+	}
+	return r;
+}
+
+// good frames with noise, sync bytes, cut-off frames and bad checksums between them
+static std::vector<uint8_t> makeStream(std::mt19937& rng, size_t frames) {
+	std::vector<uint8_t> s;
+	uint8_t frame[D1::FRAME];
+	for (size_t k = 0; k < frames; k++) {
+		makeFrame(frame, (int)(rng() % 4), (int)k);
+		switch (rng() % 6) {
+		case 0:
+			// a cut-off frame right before a good one
+			s.insert(s.end(), frame, frame + 1 + rng() % (D1::FRAME - 1));
+			break;
+		case 1: {
+			size_t noise = rng() % 40;
+			for (size_t i = 0; i < noise; i++) {
+				s.push_back(rng() % 3 == 0 ? D1::SYNC : (uint8_t)rng());
+			}
+			break;
+		}
+		case 2: {
+			uint8_t bad[D1::FRAME];
+			memcpy(bad, frame, D1::FRAME);
+			bad[1 + rng() % (D1::FRAME - 1)] ^= (uint8_t)(1 + rng() % 255);
+			s.insert(s.end(), bad, bad + D1::FRAME);
+			break;
+		}
+		default:
+			break;
+		}
+		s.insert(s.end(), frame, frame + D1::FRAME);
+	}
+	// and a frame that never finishes
+	s.insert(s.end(), frame, frame + 17);
+	return s;
+}
+
+static void testRandomChunking() {
+	std::mt19937 rng(12345);
+	std::vector<uint8_t> stream = makeStream(rng, 400);
+
+	Result whole = scan(stream, {});
+	Result ref = reference(stream);
+	CHECK(same(whole, ref));
+	CHECK(whole.frames.size() >= 400);
+	CHECK(whole.rejected > 0 && whole.resyncs > 0);
+
+	int mismatches = 0;
+	for (int run = 0; run < 5000; run++) {
+		std::vector<size_t> sizes;
+		size_t total = 0;
+		size_t maxChunk = 1 + rng() % (run % 2 ? 8 : 96);
+		while (total < stream.size()) {
+			size_t n = rng() % (maxChunk + 1);
+			sizes.push_back(n);
+			total += n;
+		}
+		if (!same(scan(stream, sizes), ref))
+			mismatches++;
+	}
+	printf("random chunkings: %d mismatches in 5000\n", mismatches);
+	CHECK(mismatches == 0);
+}
+
+static void testAllSync() {
+	std::vector<uint8_t> stream(100000, D1::SYNC);
+	Result whole = scan(stream, {});
+	CHECK(whole.frames.empty());
+	CHECK(whole.validations <= stream.size());
+
+	std::vector<size_t> sizes(stream.size() / 7 + 1, 7);
+	Result chunked = scan(stream, sizes);
+	CHECK(same(chunked, whole));
+	CHECK(chunked.validations <= stream.size());
+}
+
+int main() {
+	testRandomChunking();
+	testAllSync();
+	printf("ScannerTest passed\n");
+	return 0;
+}
@@ -0,0 +1,295 @@
+// POSIX Serial backend against a pty pair: what Read and ReadNow return
+// for whole frames, short buffers, split bursts and silence, and how an
+// Interrupt cancels a blocked wait.
+
+#include <cstring>
+#include <vector>
+
+#include "D1Scanner.hpp"
+#include "Serial.hpp"
+#include "TestUtil.hpp"
+
+static const Serial::SerialConfig CONFIG = { CBR_38400, 8, ODDPARITY, ONESTOPBIT };
+
+static void openSerial(Serial& serial, Pty& pty) {
+	CHECK(serial.Open(pty.name, CONFIG));
+	CHECK(serial.IsOpened());
+}
+
+static void testWholeFrame() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+
+	uint8_t frame[D1::FRAME];
+	makeFrame(frame, 1, 7);
+	pty.write(frame, sizeof(frame));
+
+	uint8_t buf[1024];
+	int n = serial.Read(buf, sizeof(buf));
+	CHECK(n == (int)D1::FRAME);
+	CHECK(memcmp(buf, frame, D1::FRAME) == 0);
+	CHECK(serial.Wakeups() == 1);
+	// the one wakeup found the whole frame queued
+	CHECK(serial.BacklogMax() == (double)D1::FRAME);
+	CHECK(serial.BacklogAvg() == (double)D1::FRAME);
+
+	// the vector overload returns the same bytes
+	pty.write(frame, sizeof(frame));
+	std::vector<unsigned char> v = serial.Read();
+	CHECK(v.size() == D1::FRAME);
+	CHECK(memcmp(v.data(), frame, D1::FRAME) == 0);
+}
+
+static void testShortRead() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+
+	uint8_t frame[D1::FRAME];
+	makeFrame(frame, 1, 3);
+	pty.write(frame, sizeof(frame));
+	sleepMs(10);
+
+	// a buffer smaller than what is queued takes what fits, the rest stays
+	uint8_t buf[64];
+	CHECK(serial.Read(buf, 10) == 10);
+	CHECK(memcmp(buf, frame, 10) == 0);
+	CHECK(serial.Read(buf + 10, sizeof(buf) - 10) == (int)D1::FRAME - 10);
+	CHECK(memcmp(buf, frame, D1::FRAME) == 0);
+
+	pty.write(frame, sizeof(frame));
+	sleepMs(10);
+	CHECK(serial.ReadNow(buf, 4) == 4);
+	CHECK(serial.ReadNow(buf + 4, sizeof(buf) - 4) == (int)D1::FRAME - 4);
+	CHECK(memcmp(buf, frame, D1::FRAME) == 0);
+}
+
+static void testReadNowEmpty() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+
+	uint8_t buf[64];
+	int64_t start = nowNs();
+	CHECK(serial.ReadNow(buf, sizeof(buf)) == 0);
+	CHECK(nowNs() - start < 5000000);
+	CHECK(serial.Wakeups() == 0);
+	CHECK(serial.BacklogAvg() == 0.0);
+}
+
+static void testWaitTimeout() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+	serial.SetWaitTimeout(30);
+
+	uint8_t buf[64];
+	int64_t start = nowNs();
+	CHECK(serial.Read(buf, sizeof(buf)) == 0);
+	int64_t ms = (nowNs() - start) / 1000000;
+	CHECK(ms >= 25 && ms < 500);
+
+	// waited in 10 ms slices, each one a wake latency sample
+	WakeLatency& latency = serial.Latency();
+	CHECK(latency.count() == 3);
+	CHECK(latency.maximum() >= latency.avg());
+	CHECK(latency.percentile(0.5) <= latency.percentile(0.99));
+	CHECK(latency.maximum() < 400000.0);
+}
+
+// a frame that arrives in two bursts, gap ms apart
+static int readSplit(unsigned long interByte, int gap, uint8_t* buf, size_t cap) {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+	serial.SetWaitTimeout(1000);
+	serial.SetInterByteTimeout(interByte);
+
+	uint8_t frame[D1::FRAME];
+	makeFrame(frame, 2, 11);
+	std::thread writer([&]() {
+		pty.write(frame, 10);
+		sleepMs(gap);
+		pty.write(frame + 10, D1::FRAME - 10);
+	});
+	int n = serial.Read(buf, cap);
+	writer.join();
+	CHECK(memcmp(buf, frame, n > 0 ? n : 0) == 0);
+	return n;
+}
+
+static void testInterByteTimeout() {
+	uint8_t buf[64];
+	// 0 returns with the first burst
+	CHECK(readSplit(0, 20, buf, sizeof(buf)) == 10);
+	// a gap inside the timeout is bridged, one call returns the whole frame
+	CHECK(readSplit(200, 20, buf, sizeof(buf)) == (int)D1::FRAME);
+	// a longer gap ends the read after the first burst
+	CHECK(readSplit(20, 200, buf, sizeof(buf)) == 10);
+	// a full buffer ends it too
+	CHECK(readSplit(200, 20, buf, 10) == 10);
+}
+
+static void testInterrupt() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+	serial.SetWaitTimeout(10000);
+
+	// a blocked Read returns 0 at once
+	int n = -2;
+	int64_t interrupted = 0;
+	int64_t returned = 0;
+	std::thread reader([&]() {
+		uint8_t buf[64];
+		n = serial.Read(buf, sizeof(buf));
+		returned = nowNs();
+	});
+	sleepMs(50);
+	interrupted = nowNs();
+	serial.Interrupt();
+	reader.join();
+	CHECK(n == 0);
+	CHECK(returned - interrupted < 100000000);
+
+	// and stays interrupted, even with data queued, until reset
+	uint8_t frame[D1::FRAME];
+	makeFrame(frame, 1, 1);
+	pty.write(frame, sizeof(frame));
+	uint8_t buf[64];
+	int64_t start = nowNs();
+	CHECK(serial.Read(buf, sizeof(buf)) == 0);
+	CHECK(serial.WaitInterrupt(10000));
+	CHECK(nowNs() - start < 100000000);
+
+	serial.ResetInterrupt();
+	CHECK(!serial.WaitInterrupt(20));
+	CHECK(serial.Read(buf, sizeof(buf)) == (int)D1::FRAME);
+
+	// an interrupt from another thread ends a WaitInterrupt sleep
+	std::thread waker([&]() {
+		sleepMs(30);
+		serial.Interrupt();
+	});
+	start = nowNs();
+	CHECK(serial.WaitInterrupt(10000));
+	CHECK(nowNs() - start < 1000000000);
+	waker.join();
+
+	// Open starts out uninterrupted
+	serial.Close();
+	openSerial(serial, pty);
+	CHECK(!serial.WaitInterrupt(0));
+}
+
+static void testHangup() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+	serial.SetWaitTimeout(1000);
+
+	pty.closeMaster();
+	uint8_t buf[64];
+	CHECK(serial.Read(buf, sizeof(buf)) == -1);
+}
+
+static void testWrite() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+
+	uint8_t frame[D1::FRAME];
+	makeFrame(frame, 5, 9);
+	CHECK(serial.Write(frame, sizeof(frame)) == (int)D1::FRAME);
+
+	uint8_t buf[64];
+	size_t got = 0;
+	while (got < D1::FRAME) {
+		ssize_t r = read(pty.master, buf + got, sizeof(buf) - got);
+		CHECK(r > 0);
+		got += r;
+	}
+	CHECK(got == D1::FRAME);
+	CHECK(memcmp(buf, frame, D1::FRAME) == 0);
+}
+
+static void testWriteFull() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+	serial.SetWaitTimeout(50);
+
+	// nobody reads the master, the pty fills up and the write gives up
+	std::vector<uint8_t> data(1 << 20, 0x55);
+	int64_t start = nowNs();
+	int n = serial.Write(data.data(), data.size());
+	CHECK(n > 0 && n < (int)data.size());
+	CHECK(nowNs() - start < 1000000000);
+
+	// and with the other end gone it fails
+	pty.closeMaster();
+	CHECK(serial.Write(data.data(), data.size()) == -1);
+}
+
+// bytes to poses the way the port reader does it: a stream with noise
+// between frames, read in whatever chunks the tty hands out
+static void testFramesToPoses() {
+	Pty pty;
+	Serial serial;
+	openSerial(serial, pty);
+	serial.SetWaitTimeout(500);
+	serial.SetInterByteTimeout(2);
+
+	const int FRAMES = 200;
+	std::thread writer([&]() {
+		uint8_t frame[D1::FRAME];
+		const uint8_t noise[] = { 0x00, D1::SYNC, 0x42 };
+		for (int k = 0; k < FRAMES; k++) {
+			makeFrame(frame, 1, k);
+			pty.write(frame, sizeof(frame));
+			if (k % 7 == 0)
+				pty.write(noise, sizeof(noise));
+			if (k % 20 == 0)
+				sleepMs(1);
+		}
+	});
+
+	D1Scanner scanner;
+	int next = 0;
+	bool ordered = true;
+	uint8_t buf[256];
+	while (next < FRAMES) {
+		int n = serial.Read(buf, sizeof(buf));
+		CHECK(n > 0);
+		scanner.feed(buf, (size_t)n,
+			[](const uint8_t* p) { return D1::isValid(p); },
+			[&](const uint8_t* p, size_t) {
+				uint8_t expect[D1::FRAME];
+				makeFrame(expect, 1, next);
+				D1::Pose a = D1::decode(p);
+				D1::Pose b = D1::decode(expect);
+				ordered = ordered && a.tx == b.tx && a.ty == b.ty && a.tz == b.tz &&
+					a.rx == b.rx && a.ry == b.ry && a.rz == b.rz && a.zoom == b.zoom && a.focus == b.focus;
+				next++;
+			});
+	}
+	writer.join();
+	CHECK(ordered);
+	CHECK(next == FRAMES);
+}
+
+int main() {
+	testWholeFrame();
+	testShortRead();
+	testReadNowEmpty();
+	testWaitTimeout();
+	testInterByteTimeout();
+	testInterrupt();
+	testHangup();
+	testWrite();
+	testWriteFull();
+	testFramesToPoses();
+	printf("SerialTest passed\n");
+	return 0;
+}
@@ -0,0 +1,107 @@
+// Shutter exposures on the pose history: the window ends at the newest
+// frame at the latest, the mean of a constant rate move is the pose at the
+// middle of the window, and open and close are the poses at its edges.
+
+#include <cmath>
+
+#include "PoseHistory.hpp"
+#include "TestUtil.hpp"
+
+static const int64_t DT = 20000000;	// ns between frames
+
+// dolly at 0.5 m/s, pan at 120 deg/s from 150 deg past 180, zoom at 1e6/s
+static D1::Pose linear(int64_t time) {
+	double t = time / 1e9;
+	return { 0.5 * t, 1.5, 0.0, -3.0, 150.0 + 120.0 * t, 1.0, (int32_t)std::lround(300000 + 1e6 * t), 200000 };
+}
+
+static void fill(PoseHistory& history, int frames) {
+	for (int k = 0; k < frames; k++)
+		history.push(k * DT, linear(k * DT));
+}
+
+// largest difference to the track at time, over values [from, to)
+static double error(const TimedPose& out, int64_t time, size_t from = 0, size_t to = TimedPose::VALUES) {
+	D1::Pose p = linear(time);
+	double real[TimedPose::VALUES] = { p.tx, p.ty, p.tz, p.rx, p.ry, p.rz, (double)p.zoom, (double)p.focus };
+	double e = 0.0;
+	for (size_t i = from; i < to; i++)
+		e = std::max(e, std::fabs(out.v[i] - real[i]));
+	return e;
+}
+
+// the pose of the track at time: position and lens exact, the rotation
+// a few 1e-6 deg off, interpolated and averaged quaternions stay close to
+// the arc but not on it
+static bool at(const TimedPose& out, int64_t time) {
+	return error(out, time, 0, 3) < 1e-9 && error(out, time, 6, 8) < 1e-6 && error(out, time, 3, 6) < 1e-4;
+}
+
+static void testExposure() {
+	PoseHistory history;
+	int64_t from, to;
+	CHECK(!history.exposure(0, DT, from, to));
+
+	fill(history, 10);
+	// inside the history it ends where asked
+	CHECK(history.exposure(5 * DT + 3, 8000000, from, to));
+	CHECK(to == 5 * DT + 3 && from == to - 8000000);
+	// past the newest frame it ends there, same length
+	CHECK(history.exposure(9 * DT + 15000000, 8000000, from, to));
+	CHECK(to == 9 * DT && from == 9 * DT - 8000000);
+}
+
+static void testMean() {
+	PoseHistory history;
+	fill(history, 20);
+
+	// a 180 deg shutter at 25 Hz, 20 ms, between frames and over one
+	TimedPose out;
+	int64_t from = 7 * DT + 6000000;
+	int64_t to = from + DT;
+	CHECK(history.mean(from, to, false, out));
+	CHECK(out.time == to);
+	CHECK(at(out, (from + to) / 2));
+	CHECK(history.mean(from, to, true, out));
+	CHECK(at(out, (from + to) / 2));
+
+	// over several frames the pan goes past 180 and stays wound that way
+	from = 12 * DT + 5000000;
+	to = from + 3 * DT;
+	CHECK(history.mean(from, to, true, out));
+	CHECK(out.v[4] > 180.0);
+	CHECK(at(out, (from + to) / 2));
+
+	// an empty window is the pose at its end
+	CHECK(history.mean(to, to, true, out));
+	CHECK(at(out, to));
+}
+
+static void testOpenClose() {
+	PoseHistory history;
+	fill(history, 20);
+
+	// asked for beyond the newest frame: open and close move back with it
+	int64_t from, to;
+	CHECK(history.exposure(19 * DT + 30000000, 12000000, from, to));
+	TimedPose open, close;
+	CHECK(history.sample(from, true, open));
+	CHECK(history.sample(to, true, close));
+	CHECK(open.time == 19 * DT - 12000000 && close.time == 19 * DT);
+	CHECK(at(open, from));
+	CHECK(error(close, to) < 1e-9);
+
+	// and the mean over it is the middle of the real window, not one
+	// weighted towards the held newest pose
+	TimedPose mean;
+	CHECK(history.mean(from, to, true, mean));
+	CHECK(at(mean, (from + to) / 2));
+}
+
+int main() {
+	testExposure();
+	testMean();
+	testOpenClose();
+	printf("ShutterTest passed\n");
+	return 0;
+}
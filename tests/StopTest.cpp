@@ -0,0 +1,76 @@
+// Stop latency on an idle pty: a reader blocked in a long wait, and a port
+// torn down by its last unsubscribe, both return within a few ms instead
+// of waiting out the read timeout.
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "PortRegistry.hpp"
+#include "Serial.hpp"
+#include "TestUtil.hpp"
+
+static const int RUNS = 20;
+
+static void report(const char* what, std::vector<int64_t>& ns) {
+	std::sort(ns.begin(), ns.end());
+	double median = ns[ns.size() / 2] / 1e6;
+	double max = ns.back() / 1e6;
+	printf("%s: median %.3f ms, max %.3f ms\n", what, median, max);
+	CHECK(median < 5.0);
+	// a busy machine may preempt one run, never for the 10 s timeout
+	CHECK(max < 100.0);
+}
+
+static void testInterruptRead() {
+	Pty pty;
+	Serial serial;
+	CHECK(serial.Open(pty.name, { CBR_38400, 8, ODDPARITY, ONESTOPBIT }));
+	serial.SetWaitTimeout(10000);
+
+	std::vector<int64_t> ns;
+	for (int r = 0; r < RUNS; r++) {
+		serial.ResetInterrupt();
+		std::thread reader([&]() {
+			uint8_t buf[64];
+			CHECK(serial.Read(buf, sizeof(buf)) == 0);
+		});
+		sleepMs(5);
+		int64_t start = nowNs();
+		serial.Interrupt();
+		reader.join();
+		ns.push_back(nowNs() - start);
+	}
+	report("interrupt a blocked read", ns);
+}
+
+static void testUnsubscribe(bool reactor) {
+	std::vector<int64_t> ns;
+	for (int r = 0; r < RUNS; r++) {
+		Pty pty;
+		std::unique_ptr<Mailbox> mailbox(new Mailbox());
+		std::shared_ptr<SharedPort> port = PortRegistry::Instance().Subscribe(pty.name, mailbox.get(), reactor);
+
+		int64_t end = nowNs() + 3000000000LL;
+		while (port->GetState() != SharedPort::Connected) {
+			CHECK(nowNs() < end);
+			sleepMs(1);
+		}
+		// let the reader settle into its wait
+		sleepMs(5);
+
+		int64_t start = nowNs();
+		PortRegistry::Instance().Unsubscribe(port, mailbox.get());
+		ns.push_back(nowNs() - start);
+		CHECK(port->GetState() == SharedPort::Waiting);
+	}
+	report(reactor ? "last unsubscribe, reactor" : "last unsubscribe, reader thread", ns);
+}
+
+int main() {
+	testInterruptRead();
+	testUnsubscribe(false);
+	testUnsubscribe(true);
+	printf("StopTest passed\n");
+	return 0;
+}
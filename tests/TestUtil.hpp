@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "D1Packet.hpp"
+
+// prints where and exits, ctest reports the test as failed
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+inline int64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void sleepMs(int ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// A pty pair standing in for a serial adapter: the test writes tracker
+// bytes into master, Serial opens name. The slave stays open here too, so
+// the pair lives until the master is closed.
+struct Pty {
+	int master = -1;
+	int slave = -1;
+	std::string name;
+
+	Pty() {
+		termios tio;
+		cfmakeraw(&tio);
+		char buf[128];
+		CHECK(openpty(&master, &slave, buf, &tio, nullptr) == 0);
+		name = buf;
+	}
+	Pty(const Pty&) = delete;
+	~Pty() {
+		closeMaster();
+		if (slave >= 0)
+			close(slave);
+	}
+
+	void closeMaster() {
+		if (master >= 0)
+			close(master);
+		master = -1;
+	}
+
+	void write(const uint8_t* p, size_t n) {
+		while (n > 0) {
+			ssize_t r = ::write(master, p, n);
+			CHECK(r > 0);
+			p += r;
+			n -= r;
+		}
+	}
+};
+
+// a valid frame for camera id with the eight raw 24 bit fields
+inline void makeFrame(uint8_t* p, int id, const int32_t fields[D1::FIELDS]) {
+	p[0] = D1::SYNC;
+	p[D1::CAMERA_ID] = (uint8_t)id;
+	for (size_t f = 0; f < D1::FIELDS; f++) {
+		uint32_t v = (uint32_t)fields[f] & 0xffffff;
+		p[D1::OFFSETS[f]] = (uint8_t)(v >> 16);
+		p[D1::OFFSETS[f] + 1] = (uint8_t)(v >> 8);
+		p[D1::OFFSETS[f] + 2] = (uint8_t)v;
+	}
+	p[26] = 0;
+	p[27] = 0;
+	p[D1::CHECKSUM] = D1::checkSum(p);
+}
+
+// frame k of a test stream: every field moves with k, lens near its 0x80000 offset
+inline void makeFrame(uint8_t* p, int id, int k) {
+	int32_t fields[D1::FIELDS] = { k * 3, -k * 5, k, k * 64, -k * 64, 1000 + k, 0x80000 + k, 0x80000 + 2 * k };
+	makeFrame(p, id, fields);
+}
@@ -0,0 +1,50 @@
+// Trace::Save writes JSON a strict parser accepts: thread names are
+// escaped, and values JSON cannot hold are written as null.
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "Trace.hpp"
+#include "TestUtil.hpp"
+
+static std::string readFile(const std::string& path) {
+	std::ifstream in(path);
+	std::stringstream s;
+	s << in.rdbuf();
+	return s.str();
+}
+
+int main() {
+	std::string path = "/tmp/shotoku-trace-" + std::to_string(getpid()) + ".json";
+	Trace& trace = Trace::Instance();
+	trace.Enable(true);
+
+	std::thread t([]() {
+		Trace::NameThread("cam \"A\" C:\\dev\tline");
+		Trace::Mark(Trace::Frame, 3.0);
+		Trace::Mark(Trace::Consume, NAN);
+		Trace::Mark(Trace::Consume, INFINITY);
+		Trace::Mark(Trace::Consume, -INFINITY);
+	});
+	t.join();
+	CHECK(trace.Save(path));
+	trace.Enable(false);
+
+	std::string json = readFile(path);
+	remove(path.c_str());
+
+	CHECK(json.find("\"name\":\"cam \\\"A\\\" C:\\\\dev\\u0009line\"") != std::string::npos);
+	CHECK(json.find("\"value\":3}") != std::string::npos);
+	CHECK(json.find("nan") == std::string::npos);
+	CHECK(json.find("inf") == std::string::npos);
+	size_t nulls = 0;
+	for (size_t at = json.find("\"value\":null}"); at != std::string::npos; at = json.find("\"value\":null}", at + 1)) {
+		nulls++;
+	}
+	CHECK(nulls == 3);
+
+	printf("TraceTest passed\n");
+	return 0;
+}